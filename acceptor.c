@@ -5,11 +5,16 @@
 
 struct acceptor
 {
+	int				id;
+	iid_t			max_iid;	/*acceptor¼᰸ţʱӴ洢м*/
+	iid_t			accepted_iid;	/*ֵܹ᰸ţproposerǰprepareСmax_iid*/
+	iid_t			chosen_iid;	/*proposer֪ͨͨţ̻ڴ洢*/
 	struct storage* store;
 };
 
 static acceptor_record* apply_prepare(struct storage* s, prepare_req* ar, acceptor_record* rec);
 static acceptor_record* apply_accept(struct storage* s, accept_req* ar, acceptor_record* rec);
+static void				acceptor_update_max_iid(struct acceptor* a, iid_t iid);
 
 struct acceptor* acceptor_new(int id)
 {
@@ -20,6 +25,14 @@ struct acceptor* acceptor_new(int id)
 		return NULL;
 	}
 
+	s->id = id;
+	/*ʱӴ洢жһΣ֮prepare/acceptά*/
+	s->max_iid = storage_get_max_iid(s->store);
+	s->accepted_iid = storage_get_max_accepted_iid(s->store);
+	storage_tx_begin(s->store);
+	s->chosen_iid = storage_get_chosen_iid(s->store);
+	storage_tx_commit(s->store);
+
 	return s;
 }
 
@@ -48,6 +61,7 @@ acceptor_record* acceptor_receive_prepare(struct acceptor* a, prepare_req* req)
 	/*prepare req*/
 	rec = apply_prepare(a->store, req, rec);
 	storage_tx_commit(a->store);
+	acceptor_update_max_iid(a, req->iid);
 	return rec;
 }
 
@@ -58,18 +72,78 @@ acceptor_record* acceptor_receive_accept(struct acceptor* a, accept_req* req)
 	rec = storage_get_record(a->store, req->iid);
 	/*accept_req*/
 	rec = apply_accept(a->store, req, rec);
-	storage_tx_commit(s->store);
+	storage_tx_commit(a->store);
+	acceptor_update_max_iid(a, req->iid);
+	if(rec->value_ballot == req->ballot && req->iid > a->accepted_iid)
+		a->accepted_iid = req->iid;
 
 	return rec;
 }
-acceptor_record* acceptor_receive_repeat(struct acceptor* a, iid_t iid)
+/*ȡ[*from, to)֮max¼нֵܹļ¼*fromΪ´μȡλ(ʱΪto)*/
+int acceptor_receive_repeats(struct acceptor* a, iid_t* from, iid_t to, acceptor_record** recs, int max)
 {
-	acceptor_record* rec;
+	int i, n, count = 0;
+
 	storage_tx_begin(a->store);
-	rec = storage_get_record(a->store, iid);
+	n = storage_get_records(a->store, *from, to, recs, max);
 	storage_tx_commit(a->store);
-	return rec;
+
+	*from = (n == max) ? recs[n - 1]->iid + 1 : to;
+
+	/*ֻprepareûнֵܹļ¼طlearnerһֵaccept*/
+	for(i = 0; i < n; i++){
+		if(recs[i]->value_ballot == 0)
+			storage_free_record(a->store, recs[i]);
+		else
+			recs[count++] = recs[i];
+	}
+
+	return count;
 }
+
+/*phase 0ѯؼ¼᰸ź͸᰸ϳŵballot
+  learnerָʱֻýֵܹţֻprepare᰸acceptorط*/
+void acceptor_receive_max_iid(struct acceptor* a, max_iid_ack* out)
+{
+	acceptor_record* rec = NULL;
+
+	out->acceptor_id = a->id;
+	out->iid = a->max_iid;
+	out->ballot = 0;
+	out->chosen_iid = a->chosen_iid;
+	out->accepted_iid = a->accepted_iid;
+
+	if(a->max_iid > 0){
+		storage_tx_begin(a->store);
+		rec = storage_get_record(a->store, a->max_iid);
+		storage_tx_commit(a->store);
+	}
+
+	if(rec != NULL){
+		out->ballot = rec->ballot;
+		storage_free_record(a->store, rec);
+	}
+}
+
+/*proposer֪ͨiidΪֹѾֻͨ*/
+void acceptor_receive_chosen_upto(struct acceptor* a, iid_t iid)
+{
+	if(iid <= a->chosen_iid)
+		return;
+
+	paxos_log_debug("Chosen up to iid: %u", iid);
+	a->chosen_iid = iid;
+	storage_tx_begin(a->store);
+	storage_save_chosen_iid(a->store, iid);
+	storage_tx_commit(a->store);
+}
+
+static void acceptor_update_max_iid(struct acceptor* a, iid_t iid)
+{
+	if(iid > a->max_iid)
+		a->max_iid = iid;
+}
+
 static acceptor_record* apply_prepare(struct storage* s, prepare_req* pr, acceptor_record* rec)
 {
 	/*СڱacceptorѽܵID飬ܵϢ*/
@@ -12,6 +12,8 @@ void				acceptor_free_record(struct acceptor* a, acceptor_record* r);
 
 acceptor_record*	acceptor_receive_prepare(struct acceptor* a, prepare_req* req);
 acceptor_record*	acceptor_receive_accept(struct acceptor* a, accept_req* req);
-acceptor_record*	acceptor_receive_repeat(struct acceptor* a, iid_t iid);
+int					acceptor_receive_repeats(struct acceptor* a, iid_t* from, iid_t to, acceptor_record** recs, int max);
+void				acceptor_receive_max_iid(struct acceptor* a, max_iid_ack* out);
+void				acceptor_receive_chosen_upto(struct acceptor* a, iid_t iid);
 
 #endif
@@ -3,12 +3,13 @@
 #include <signal.h>
 
 #include "evpaxos.h"
+#include <event2/thread.h>
 
 void handle_sigint(int sig, short ev, void* arg)
 {
 	struct event_base* base = arg;
 	printf("Caught signal %d\n", sig);
-	event_base_lookexit(base, NULL);
+	event_base_loopexit(base, NULL);
 }
 
 int main(int argc, const char* argv[])
@@ -22,6 +23,12 @@ int main(int argc, const char* argv[])
 		printf("Usage %s id config\n", argv[0]);
 		return 0;
 	}
+	/*acceptor-net-threadsʱ߳̿߳д̵߳ӣڴκevent_base֮ǰ*/
+	if(evthread_use_pthreads() != 0){
+		printf("libevent has no pthreads support\n");
+		return 0;
+	}
+
 	/*libevent base*/
 	base = event_base_new();
 
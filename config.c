@@ -15,8 +15,10 @@ struct evpaxos_config
 {
 	int proposers_count;
 	int acceptors_count;
+	int relays_count;
 	struct address proposers[MAX_N_OF_PROPOSERS];
 	struct address acceptors[MAX_N_OF_PROPOSERS];
+	struct address relays[MAX_N_OF_PROPOSERS];
 };
 
 enum option_type
@@ -37,9 +39,26 @@ struct option
 struct option options[] = 
 {
 	{ "verbosity", &paxos_config.verbosity, option_verbosity },
+	{ "learner-instances", &paxos_config.learn_instances, option_integer },
 	{ "learner-catch-up", &paxos_config.learner_catch_up, option_boolean },
+	{ "learner-delivery-thread", &paxos_config.learner_delivery_thread, option_boolean },
+	{ "learner-delivery-queue", &paxos_config.learner_delivery_queue, option_integer },
+	{ "learner-relay", &paxos_config.learner_relay, option_integer },
+	{ "chosen-broadcast", &paxos_config.chosen_broadcast, option_boolean },
+	{ "peer-queue-high", &paxos_config.peer_queue_high, option_integer },
+	{ "peer-queue-low", &paxos_config.peer_queue_low, option_integer },
+	{ "peer-slow-disconnect", &paxos_config.peer_slow_disconnect, option_boolean },
+	{ "io-uring", &paxos_config.io_uring, option_boolean },
+	{ "multicast-group", &paxos_config.multicast_group, option_string },
+	{ "multicast-port", &paxos_config.multicast_port, option_integer },
+	{ "multicast-interface", &paxos_config.multicast_interface, option_string },
+	{ "multicast-ttl", &paxos_config.multicast_ttl, option_integer },
+	{ "multicast-mtu", &paxos_config.multicast_mtu, option_integer },
 	{ "proposer-timeout", &paxos_config.proposer_timeout, option_integer },
 	{ "proposer-preexec-window", &paxos_config.proposer_preexec_window, option_integer },
+	{ "acceptor-net-threads", &paxos_config.acceptor_net_threads, option_integer },
+	{ "acceptor-credit-instances", &paxos_config.acceptor_credit_instances, option_integer },
+	{ "acceptor-credit-bytes", &paxos_config.acceptor_credit_bytes, option_integer },
 	{ "bdb-sync", &paxos_config.bdb_sync, option_boolean },
 	{ "bdb-cachesize", &paxos_config.bdb_cachesize, option_integer },
 	{ "bdb-env-path", &paxos_config.bdb_env_path, option_string },
@@ -51,7 +70,7 @@ struct option options[] =
 static int parse_line(struct evpaxos_config* c, char* line);
 static void address_init(struct address* a, char* addr, int port);
 static void address_free(struct address* a);
-static struct sockaddr_in address_to_sockaddr(struct address* a);
+static struct transport_addr address_to_transport(struct address* a, int listen);
 
 struct evpaxos_config* evpaxos_config_read(const char* path)
 {
@@ -80,6 +99,13 @@ struct evpaxos_config* evpaxos_config_read(const char* path)
 	}
 
 	fclose(f);
+
+	/*chosen-broadcastֵҪ鲥мַproposerҪÿֵÿlearnerȳֻǴacceptorsƵleader*/
+	if(paxos_config.chosen_broadcast && paxos_config.multicast_group == NULL && c->relays_count == 0){
+		printf("Warning: chosen-broadcast needs multicast-group or learner relays, disabled\n");
+		paxos_config.chosen_broadcast = 0;
+	}
+
 	return c;
 }
 
@@ -91,16 +117,24 @@ void evpaxos_config_free(struct evpaxos_config* config)
 
 	for(i = 0; i < config->acceptors_count; i ++)
 		address_free(&config->acceptors[i]);
+
+	for(i = 0; i < config->relays_count; i ++)
+		address_free(&config->relays[i]);
 }
 
-int paxos_proposer_count(struct evpaxos_config* c)
+int evpaxos_proposer_count(struct evpaxos_config* c)
 {
 	return c->proposers_count;
 }
 
-struct sockaddr_in evpaxos_proposer_address(struct evpaxos_config* c, int i)
+struct transport_addr evpaxos_proposer_address(struct evpaxos_config* c, int i)
 {
-	return address_to_sockaddr(&c->proposers[i]);
+	return address_to_transport(&c->proposers[i], 0);
+}
+
+struct transport_addr evpaxos_proposer_listen_address(struct evpaxos_config* c, int i)
+{
+	return address_to_transport(&c->proposers[i], 1);
 }
 
 int evpaxos_proposer_listen_port(struct evpaxos_config* config, int i)
@@ -114,9 +148,14 @@ int evpaxos_acceptor_count(struct evpaxos_config* config)
 	return config->acceptors_count;
 }
 
-struct sockaddr_in evpaxos_acceptor_address(struct evpaxos_config* config, int i)
+struct transport_addr evpaxos_acceptor_address(struct evpaxos_config* config, int i)
 {
-	return address_to_sockaddr(&config->acceptors[i]);
+	return address_to_transport(&config->acceptors[i], 0);
+}
+
+struct transport_addr evpaxos_acceptor_listen_address(struct evpaxos_config* config, int i)
+{
+	return address_to_transport(&config->acceptors[i], 1);
 }
 
 int evpaxos_acceptor_listen_port(struct evpaxos_config* config, int i)
@@ -124,6 +163,26 @@ int evpaxos_acceptor_listen_port(struct evpaxos_config* config, int i)
 	return config->acceptors[i].port;
 }
 
+int evpaxos_relay_count(struct evpaxos_config* config)
+{
+	return config->relays_count;
+}
+
+struct transport_addr evpaxos_relay_address(struct evpaxos_config* config, int i)
+{
+	return address_to_transport(&config->relays[i], 0);
+}
+
+struct transport_addr evpaxos_relay_listen_address(struct evpaxos_config* config, int i)
+{
+	return address_to_transport(&config->relays[i], 1);
+}
+
+int evpaxos_relay_listen_port(struct evpaxos_config* config, int i)
+{
+	return config->relays[i].port;
+}
+
 static char* strtrim(char* string)
 {
 	char *s, *t;
@@ -177,12 +236,20 @@ static int parse_address(char* str, struct address* addr)
 	int id;
 	int port;
 	char address[128];
-	int rv = sscanf(str, "%d %s %d", &id, address, &port);
-	if (rv == 3) {
-		address_init(addr, address, port);
-		return 1;
+	struct transport_addr ta;
+	int rv = sscanf(str, "%d %127s %d", &id, address, &port);
+	/*unix:shm:ַûж˿*/
+	if (rv == 2 && (strncmp(address, "unix:", 5) == 0 || strncmp(address, "shm:", 4) == 0))
+		port = 0;
+	else if (rv != 3)
+		return 0;
+
+	if (transport_addr_parse(address, port, 0, &ta) != 0) {
+		printf("Invalid address %s\n", address);
+		return 0;
 	}
-	return 0;
+	address_init(addr, address, port);
+	return 1;
 }
 
 static int parse_verbosity(char* str, int* verbosity)
@@ -238,6 +305,16 @@ static int parse_line(struct evpaxos_config* c, char* line)
 		return parse_address(line, addr);
 	}
 
+	if (strcasecmp(tok, "r") == 0) {
+		if (c->relays_count >= MAX_N_OF_PROPOSERS) {
+			printf("Number of relays exceded maximum of: %d\n",
+				MAX_N_OF_PROPOSERS);
+			return 0;
+		}
+		struct address* addr = &c->relays[c->relays_count++];
+		return parse_address(line, addr);
+	}
+
 	line = strtrim(line);
 	opt = lookup_option(tok);
 	if (opt == NULL)
@@ -276,14 +353,11 @@ static void address_free(struct address* a)
 	free(a->addr);
 }
 
-static struct sockaddr_in address_to_sockaddr(struct address* a) 
+static struct transport_addr address_to_transport(struct address* a, int listen)
 {
-	struct sockaddr_in addr;
-	memset(&addr, 0, sizeof(struct sockaddr_in));
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(a->port);
-	addr.sin_addr.s_addr = inet_addr(a->addr);
-	
+	struct transport_addr addr;
+	/*ʱѾ*/
+	transport_addr_parse(a->addr, a->port, listen, &addr);
 	return addr;
 }
 
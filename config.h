@@ -2,6 +2,7 @@
 #define __CONFIG_READER_H_
 
 #include "evpaxos.h"
+#include "transport.h"
 
 struct evpaxos_config;
 
@@ -11,10 +12,18 @@ void					evpaxos_config_free(struct evpaxos_config* config);
 int						evpaxos_proposer_count(struct evpaxos_config* c);
 int						evpaxos_acceptor_count(struct evpaxos_config* c);
 
-struct sockaddr_in		evpaxos_proposer_address(struct evpaxos_config* c, int i);
+/*ַ"host port""unix:path""shm:name"transport.h*/
+struct transport_addr	evpaxos_proposer_address(struct evpaxos_config* c, int i);
+struct transport_addr	evpaxos_proposer_listen_address(struct evpaxos_config* c, int i);
 int						evpaxos_proposer_listen_port(struct evpaxos_config* c, int i);
-struct sockaddr_in		evpaxos_acceptor_address(struct evpaxos_config* c, int i);
+struct transport_addr	evpaxos_acceptor_address(struct evpaxos_config* c, int i);
+struct transport_addr	evpaxos_acceptor_listen_address(struct evpaxos_config* c, int i);
 int						evpaxos_acceptor_listen_port(struct evpaxos_config* c, int i);
 
+int						evpaxos_relay_count(struct evpaxos_config* c);
+struct transport_addr	evpaxos_relay_address(struct evpaxos_config* c, int i);
+struct transport_addr	evpaxos_relay_listen_address(struct evpaxos_config* c, int i);
+int						evpaxos_relay_listen_port(struct evpaxos_config* c, int i);
+
 #endif
 
@@ -9,10 +9,13 @@
 #include "acceptor.h"
 #include "libpaxos_message.h"
 #include "tcp_sendbuf.h"
+#include "tcp_recvbuf.h"
+#include "multicast.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/ioctl.h>
 
 struct evacceptor
 {
@@ -21,8 +24,33 @@ struct evacceptor
 	struct event_base*		base;				/*libevent base*/
 	struct tcp_receiver*	receiver;			/*TCP receiver,һlearner*/
 	struct evpaxos_config*	conf;				
+	struct mcast*			mcast_reqs;			/*鲥proposeraccept reqsû鲥ʱΪNULL*/
+	struct mcast*			mcast_acks;			/*鲥ֵaccept ackslearners*/
+	struct mcast*			mcast_proposers;	/*鲥ֵacksͶȸproposers*/
+	struct carray*			repeats;			/*ûطrepeatÿ¼صһ*/
+	struct event*			repeat_ev;
+	int						credit_acks;		/*ϴ֮Ӧaccept*/
+	credit_msg				credit;				/*ϴĶ*/
+	struct event*			backlog_ev;			/*ʱѹ*/
+	int						backlog_msgs;		/*ϴβʱ̶߳Ϣ*/
+	long					backlog_bytes;		/*ϴβʱproposerûдֽ*/
 };
 
+/*ȱ仯1/ACCEPTOR_CREDIT_CHANGEʱ裬Сı仯ÿӦACCEPTOR_CREDIT_INTERVALacceptһΣûб仯*/
+#define ACCEPTOR_CREDIT_INTERVAL	64
+#define ACCEPTOR_CREDIT_CHANGE		8
+/*ѹĲ(΢)*/
+#define ACCEPTOR_BACKLOG_SAMPLE		10000
+
+/*ֻproposerزֵackaccept req鲥(bevΪNULL)ʱص鲥*/
+static void send_accept_ack_header(struct evacceptor* a, struct bufferevent* bev, acceptor_record* rec)
+{
+	if(bev != NULL)
+		sendbuf_add_accept_ack_header(bev, rec);
+	else
+		mcast_add_accept_ack_header(a->mcast_proposers, rec);
+}
+
 /*Received a prepare request (phase 1a).*/
 static void handle_prepare_req(struct evacceptor* a, struct bufferevent* bev, prepare_req* pr)
 {
@@ -35,6 +63,66 @@ static void handle_prepare_req(struct evacceptor* a, struct bufferevent* bev, pr
 	acceptor_free_record(a->state, rec);
 }
 
+/*ϻûдֽ: ںsocketջ(FIONREAD)Ѿ뻺ġ
+  ߳ʱ洢ϣѹҪsocketջio_uring͹ڴȡfdֻ뻺*/
+static long connection_backlog(struct bufferevent* bev)
+{
+	int unread = 0;
+	evutil_socket_t fd = bufferevent_getfd(bev);
+
+	if(fd < 0 || ioctl(fd, FIONREAD, &unread) != 0)
+		unread = 0;
+
+	return unread + (long)evbuffer_get_length(bufferevent_get_input(bev));
+}
+
+/*ʱѹÿackȡ߳ģʽӵĻ̵ֻ̣߳߳̽߳Ķȣ
+  ߳ڶʱֹͣȡĻѹsocket߳ʱǸproposerûжȡֽ*/
+static void sample_backlog(evutil_socket_t fd, short event, void* arg)
+{
+	int i;
+	struct evacceptor* a = (struct evacceptor *)arg;
+	struct carray* proposers;
+
+	a->backlog_msgs = tcp_receiver_backlog(a->receiver);
+	a->backlog_bytes = 0;
+	if(paxos_config.acceptor_net_threads <= 0){
+		proposers = tcp_receiver_get_proposers(a->receiver);
+		for(i = 0; i < carray_count(proposers); i++)
+			a->backlog_bytes += connection_backlog(carray_at(proposers, i));
+	}
+}
+
+/*õĶп۳Ļѹ: ̶߳Ϣûжȡֽ(ǰaccept reqĴС᰸)
+  proposer;ҲЩѹ洢ʱָ*/
+static void send_credit(struct evacceptor* a, struct bufferevent* bev, size_t msg_size)
+{
+	int instances = paxos_config.acceptor_credit_instances - a->backlog_msgs - (int)(a->backlog_bytes / msg_size);
+	long bytes = paxos_config.acceptor_credit_bytes - a->backlog_bytes;
+	int changed;
+	credit_msg cm;
+
+	cm.acceptor_id = a->acceptor_id;
+	cm.instances = instances > 0 ? instances : 0;
+	cm.bytes = bytes > 0 ? bytes : 0;
+
+	changed = cm.instances != a->credit.instances || cm.bytes != a->credit.bytes;
+	if(!changed)
+		return;
+
+	if(++a->credit_acks < ACCEPTOR_CREDIT_INTERVAL
+		&& abs((int)cm.instances - (int)a->credit.instances) < paxos_config.acceptor_credit_instances / ACCEPTOR_CREDIT_CHANGE
+		&& labs((long)cm.bytes - (long)a->credit.bytes) < paxos_config.acceptor_credit_bytes / ACCEPTOR_CREDIT_CHANGE)
+		return;
+
+	if(bev != NULL)
+		sendbuf_add_credit(bev, &cm);
+	else
+		mcast_add_credit(a->mcast_proposers, &cm);
+	a->credit = cm;
+	a->credit_acks = 0;
+}
+
 /*Received a accept request (phase 2a).*/
 static void handle_accept_req(struct evacceptor* a, struct bufferevent* bev, accept_req* ar)
 {
@@ -44,47 +132,127 @@ static void handle_accept_req(struct evacceptor* a, struct bufferevent* bev, acc
 
 	struct carray* bevs = tcp_receiver_get_events(a->receiver);
 	acceptor_record* rec = acceptor_receive_accept(a->state, ar);
-	if(ar->ballot == rec->ballot){/*ѽ鰸е(proposerlearner)ack,*/
-		for(i = 0; i < carray_count(bevs); i++)
-			sendbuf_add_accept_ack(carray_at(&bevs, i), rec);
+	if(ar->ballot == rec->ballot && paxos_config.chosen_broadcast){
+		/*proposer㲥learnersֻproposerزֵack*/
+		send_accept_ack_header(a, bev, rec);
+	}
+	else if(ar->ballot == rec->ballot){/*ѽ鰸е(proposerlearner)ack,鲥ʱlearnersproposers鲥һ*/
+		if(a->mcast_acks != NULL && mcast_add_accept_ack(a->mcast_acks, rec) == 0)
+			mcast_add_accept_ack_header(a->mcast_proposers, rec);
+		else{
+			for(i = 0; i < carray_count(bevs); i++){
+				struct bufferevent* to = carray_at(bevs, i);
+				/*proposerֻҪ(acceptor_id, iid, ballot)ֵֻlearnersûɫ*/
+				if(tcp_receiver_get_role(a->receiver, to) == role_proposer)
+					sendbuf_add_accept_ack_header(to, rec);
+				else
+					sendbuf_add_accept_ack(to, rec);
+			}
+		}
 	}
 	else{/*Ϊ飬nackproposeµ᰸*/
-		sendbuf_add_accept_ack(bev, rec);
+		send_accept_ack_header(a, bev, rec);
 	}
+	/*ȸack棬ackͬһ﷢*/
+	send_credit(a, bev, sizeof(paxos_msg) + ACCEPT_REQ_SIZE(ar));
 	
 	acceptor_free_record(a->state, rec);
 }
 
-/*repeat reqs*/
-static void handle_repeat_req(struct evacceptor* a, struct bufferevent* bev, iid_t iid)
+/*һrepeatط᰸ֹһlearnerѹacceptor*/
+#define ACCEPTOR_REPEAT_MAX 10000
+/*һ¼صȡļ¼ʣµó¼ѭ*/
+#define ACCEPTOR_REPEAT_BATCH 256
+
+/*һûطrepeatӹرպbevΪNULL*/
+struct repeat_job
 {
-	paxos_log_debug("Handling repeat for instance %d", iid);
-	acceptor_record* rec = acceptor_receive_repeat(a->state, iid);
-	if(rec != NULL){
-		sendbuf_add_accept_ack(bev, rec); /*طһaccept_acks*/
-		acceptor_free_record(a->state, rec);
-	}
+	struct bufferevent*	bev;
+	iid_t				from;
+	iid_t				to;
+};
+
+/*repeat reqs, һطһڵ᰸кȡ*/
+static void handle_repeat_req(struct evacceptor* a, struct bufferevent* bev, repeat_req* rr)
+{
+	struct repeat_job* job;
+
+	if(bev == NULL || rr->from >= rr->to)
+		return;
+
+	job = (struct repeat_job *)malloc(sizeof(struct repeat_job));
+	job->bev = bev;
+	job->from = rr->from;
+	job->to = rr->to;
+	if(job->to > rr->from + ACCEPTOR_REPEAT_MAX)
+		job->to = rr->from + ACCEPTOR_REPEAT_MAX;
+
+	paxos_log_debug("Handling repeat for instance %u-%u", job->from, job->to);
+	carray_push_back(a->repeats, job);
+	event_active(a->repeat_ev, EV_TIMEOUT, 0);
 }
 
-static void handle_req(struct bufferevent* bev, void* arg)
+/*Ӷ׵ȡһ¼طûɵķŻضβlearner*/
+static void handle_repeats(evutil_socket_t fd, short event, void* arg)
 {
-	paxos_msg msg;
-	struct evbuffer* in;
-	char* buffer = NULL;
+	int i, n;
+	struct repeat_job* job;
+	acceptor_record* recs[ACCEPTOR_REPEAT_BATCH];
+	struct evacceptor* a = (struct evacceptor *)arg;
 
-	/*Ϣͷ*/
+	job = carray_pop_front(a->repeats);
+	if(job == NULL)
+		return;
+
+	if(job->bev != NULL){
+		n = acceptor_receive_repeats(a->state, &job->from, job->to, recs, ACCEPTOR_REPEAT_BATCH);
+		sendbuf_cork();
+		for(i = 0; i < n; i++){
+			sendbuf_add_accept_ack(job->bev, recs[i]); /*طһaccept_acks*/
+			acceptor_free_record(a->state, recs[i]);
+		}
+		sendbuf_uncork();
+	}
+
+	if(job->bev != NULL && job->from < job->to)
+		carray_push_back(a->repeats, job);
+	else
+		free(job);
+
+	if(!carray_empty(a->repeats))
+		event_active(a->repeat_ev, EV_TIMEOUT, 0);
+}
+
+/*ӹرգûɵrepeat*/
+static void handle_close(struct bufferevent* bev, void* arg)
+{
+	int i;
 	struct evacceptor* a = (struct evacceptor *)arg;
-	evbuffer_remove(in, &msg, sizeof(paxos_msg));
-	
-	/*Ϣ*/
-	if(msg.data_size > 0){
-		buffer = malloc(msg.data_size);
-		assert(buffer != NULL);
-		evbuffer_remove(in, buffer, msg.data_size);
+
+	for(i = 0; i < carray_count(a->repeats); i++){
+		struct repeat_job* job = carray_at(a->repeats, i);
+		if(job->bev == bev)
+			job->bev = NULL;
 	}
+}
+
+/*proposerӹʱѯacceptor᰸(phase 0)*/
+static void handle_max_iid_req(struct evacceptor* a, struct bufferevent* bev)
+{
+	max_iid_ack ack;
+	acceptor_receive_max_iid(a->state, &ack);
+	paxos_log_debug("Handling max iid request, max iid %u ballot %u", ack.iid, ack.ballot);
+	sendbuf_add_max_iid_ack(bev, &ack);
+}
+
+/*acceptorϢӿڣbufferѾϢ*/
+static void handle_msg(struct bufferevent* bev, paxos_msg* msg, void* body, void* arg)
+{
+	char* buffer = body;
+	struct evacceptor* a = (struct evacceptor *)arg;
 
 	/*Ϣ*/
-	switch(msg.type){
+	switch(msg->type){
 	case prepare_reqs:
 		handle_prepare_req(a, bev, (prepare_req *)buffer);
 		break;
@@ -94,20 +262,39 @@ static void handle_req(struct bufferevent* bev, void* arg)
 		break;
 
 	case repeat_reqs:
-		handle_repeat_req(a, bev, *(iid_t *)buffer)
+		handle_repeat_req(a, bev, (repeat_req *)buffer);
+		break;
+
+	case max_iid_reqs:
+		handle_max_iid_req(a, bev);
+		break;
+
+	case chosen_upto_msgs:
+		acceptor_receive_chosen_upto(a->state, ((chosen_upto_msg *)buffer)->iid);
 		break;
 
 	default:
-		paxos_log_error("Unknow msg type %d not handled", msg.type);
+		paxos_log_error("Unknow msg type %d not handled", msg->type);
 	}
+}
 
-	if(buffer != NULL)
-		free(buffer);
+/*鲥ֻaccept reqsûӿԻظ*/
+static void handle_mcast_msg(paxos_msg* msg, void* body, void* arg)
+{
+	if(msg->type == accept_reqs)
+		handle_accept_req((struct evacceptor *)arg, NULL, (accept_req *)body);
+}
+
+static void handle_mcast(struct evbuffer* in, void* arg)
+{
+	recvbuf_dispatch(in, handle_mcast_msg, arg);
 }
 
 struct evacceptor* evacceptor_init(int id, const char* config, struct event_base* b)
 {
-	int port, acceptor_count;
+	int acceptor_count;
+	struct transport_addr addr;
+	struct timeval backlog_tv = {0, ACCEPTOR_BACKLOG_SAMPLE};
 	struct evacceptor* a = (struct evacceptor *)malloc(sizeof(struct evacceptor));
 	
 	/*ȡļϢ,һpaxos_config*/
@@ -117,8 +304,8 @@ struct evacceptor* evacceptor_init(int id, const char* config, struct event_base
 		return NULL;
 	}
 
-	/*ȡ˿*/
-	port = evpaxos_proposer_listen_port(a->conf, id);
+	/*ȡַ*/
+	addr = evpaxos_acceptor_listen_address(a->conf, id);
 	/*ȡacceptorĸ*/
 	acceptor_count = evpaxos_acceptor_count(a->conf);
 	/*ǷϢ*/
@@ -130,11 +317,47 @@ struct evacceptor* evacceptor_init(int id, const char* config, struct event_base
 
 	a->acceptor_id = id;
 	a->base = b;
-	/*һtcp recevieröӦϢص*/
-	a->receiver = tcp_receiver_new(b, port, handle_req, a); 
+	a->repeats = carray_new(16);
+	a->repeat_ev = event_new(b, -1, 0, handle_repeats, a);
+	a->credit_acks = 0;
+	a->credit.instances = paxos_config.acceptor_credit_instances;
+	a->credit.bytes = paxos_config.acceptor_credit_bytes;
+	a->backlog_msgs = 0;
+	a->backlog_bytes = 0;
+	a->backlog_ev = NULL;
+	/*һtcp recevieröӦϢص߳ʱշͽ߳нУ
+	  ֻ߳˳Ϣʹ洢*/
+	if(paxos_config.acceptor_net_threads > 0)
+		a->receiver = tcp_receiver_new_threads(b, &addr, paxos_config.acceptor_net_threads, handle_msg, a);
+	else
+		a->receiver = tcp_receiver_new(b, &addr, handle_msg, a);
+	if(a->receiver == NULL){
+		event_free(a->repeat_ev);
+		carray_free(a->repeats);
+		evpaxos_config_free(a->conf);
+		free(a);
+		return NULL;
+	}
+	tcp_receiver_set_close_cb(a->receiver, handle_close);
+	a->backlog_ev = event_new(b, -1, EV_PERSIST, sample_backlog, a);
+	event_add(a->backlog_ev, &backlog_tv);
 	/*һacceptϢ*/
 	a->state = acceptor_new(id); 
 
+	/*Ƚack鲥ٿʼ鲥accept reqs*/
+	a->mcast_reqs = NULL;
+	a->mcast_proposers = NULL;
+	a->mcast_acks = mcast_new(b, mcast_accept_acks, NULL, NULL);
+	if(a->mcast_acks != NULL)
+		a->mcast_proposers = mcast_new(b, mcast_proposer_acks, NULL, NULL);
+	if(a->mcast_proposers != NULL)
+		a->mcast_reqs = mcast_new(b, mcast_accept_reqs, handle_mcast, a);
+	if(paxos_config.multicast_group != NULL && a->mcast_reqs == NULL){
+		paxos_log_error("Acceptor %d failed to join multicast group %s", id, paxos_config.multicast_group);
+		evacceptor_free(a);
+		return NULL;
+	}
+
 	return a;
 }
 
@@ -147,9 +370,23 @@ int evacceptor_free(struct evacceptor* a)
 		if(a->receiver != NULL)
 			tcp_receiver_free(a->receiver);
 
+		mcast_free(a->mcast_reqs);
+		mcast_free(a->mcast_acks);
+		mcast_free(a->mcast_proposers);
+
+		while(!carray_empty(a->repeats))
+			free(carray_pop_front(a->repeats));
+		carray_free(a->repeats);
+		event_free(a->repeat_ev);
+		if(a->backlog_ev != NULL)
+			event_free(a->backlog_ev);
+
 		if(a->conf != NULL)
 			evpaxos_config_free(a->conf);
+		free(a);
 	}
+
+	return 0;
 }
 
 
@@ -2,9 +2,18 @@
 #include "learner.h"
 #include "peers.h"
 #include "tcp_sendbuf.h"
+#include "tcp_recvbuf.h"
 #include "config.h"
+#include "spsc_ring.h"
+#include "relay.h"
+#include "multicast.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <event2/event.h>
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
@@ -13,119 +22,629 @@
 struct evlearner
 {
 	struct learner*			state;		/*learnerϢ*/	
-	deliver_function*		delfun;		/*᰸call back*/
+	deliver_function		delfun;		/*᰸call back*/
 	void*					delarg;		/*defunص*/
+	deliver_batch_function	batchfun;	/*call back˾Ͳٵdelfun*/
+	int						max_batch;	/*һ᰸*/
+	struct paxos_delivery*	batch;		/**/
+	accept_ack**			batch_acks;	/*ÿֵڵackصͷ*/
+	struct event_base*		base;		/*libevent base*/
 	struct event*			hole_timer;	/*holesĶʱ*/
 	struct timeval			tv;			/*ʱʱ*/
 	struct peers*			acceptors;	/*acceptorsӹ*/
+
+	/*״̬ͬһʱֻһ;*/
+	int						repair_acceptor;	/*𲹶ĵһacceptorʱ޽չʱлһ*/
+	iid_t					repair_from;		/*;Ĳ[repair_from, repair_to)*/
+	iid_t					repair_to;
+	struct timeval			repair_time;		/*ķʱ*/
+
+	/*gap⣬holeʵرռֵhole_timer*/
+	struct event*			gap_timer;
+	iid_t					gap_iid;			/*ǰ᰸ţ0ʾûgap*/
+	long					arrival_us;			/*ʵرռĻƽ(us)*/
+	struct timeval			last_arrival;		/*һʵرյʱ*/
+	iid_t					last_closed;		/*һβʱlearner_closed_countֵ*/
+
+	/*̣߳learner-delivery-threadʱֻ߳ͨ᰸Ždeliver_ring
+	  pullģʽûз̣߳Ӧõevlearner_next/evlearner_pollȡ*/
+	struct spsc_ring*		deliver_ring;
+	int						pull;
+	int						notify_fd;			/*pullģʽµeventfdµ᰸ʱɶ*/
+	pthread_t				deliver_thread;
+	pthread_mutex_t			deliver_mutex;
+	pthread_cond_t			deliver_cond;
+	int						deliver_waiting;	/*߳ڵȴµ᰸*/
+	int						deliver_stop;
+	int						reads_paused;		/*ˣͣȡacceptorϢ*/
+	struct event*			resume_timer;
+
+	struct relay*			relay;				/*Ϊмʱѷ᰸תlearner*/
+	struct peers*			proposers;			/*chosen-broadcastģʽµproposersӣchosenϢ鲥˵ֵ*/
+	struct mcast*			mcast;				/*鲥acceptorsaccept acksacceptorsֻڲ*/
 };
 
 #define LEARNER_CHUNNK 10000
+#define LEARNER_REPAIR_TIMEOUT 500 /*ms, ʱ޽չлacceptor*/
 
-static void learner_check_holes(evutil_socket_t fd, short event, void* arg)
+#define LEARNER_GAP_FACTOR	8		/*gapƽıΪackʧ*/
+#define LEARNER_GAP_MIN		1000	/*us*/
+#define LEARNER_GAP_MAX		100000	/*us, hole_timer*/
+
+#define LEARNER_THREAD_BATCH	64		/*ûʱ߳һδӶȡ*/
+#define LEARNER_RESUME_CHECK	1000	/*us, ǷԻָȡļ*/
+
+static long timeval_diff_ms(struct timeval* t1, struct timeval* t2)
 {
-	int i;
-	iid_t iid, from, to;
-	struct evlearner* l = (struct evlearner*)arg;
+	return (t2->tv_sec - t1->tv_sec) * 1000 + (t2->tv_usec - t1->tv_usec) / 1000;
+}
+
+/*acceptorһط󡣵acceptor֪᰸ǷѾͨ
+  learnerҪacceptorackȷϾ飬Ǵrepair_acceptorʼһquorum*/
+static void learner_send_repeat(struct evlearner* l, iid_t from, iid_t to)
+{
+	int i, count, quorum;
+
+	count = peers_count(l->acceptors);
+	quorum = paxos_quorum(count);
+	for(i = 0; i < quorum; i++){
+		struct bufferevent* bev = peers_get_buffer(l->acceptors, (l->repair_acceptor + i) % count);
+		if(bev != NULL) /*acceptorrepairʱỻһacceptor*/
+			sendbuf_add_repeat_req(bev, from, to);
+	}
+}
+
+static void learner_repair_holes(struct evlearner* l)
+{
+	iid_t from, to, end;
+	struct timeval now;
 
 	/*holes,Ƿеȴɵ᰸*/
-	if(learner_has_holes(l->state, &from, &to)){
-		if(to - from > LEARNER_CHUNNK)
-			to = from + LEARNER_CHUNNK;
-
-		for(iid = from; iid < to; iid ++){
-			for(i = 0; i < peers_count(l->acceptors); i ++){ /*acceptor;*/
-				struct bufferevent* bev = peers_get_buffer(l->acceptors, i);
-				sendbuf_add_repeat_req(bev, iid);
-			}
+	if(!learner_has_holes(l->state, &from, &to)){
+		l->repair_to = 0;
+		return;
+	}
+
+	end = from + LEARNER_CHUNNK;
+
+	event_base_gettimeofday_cached(l->base, &now);
+	if(from < l->repair_to){ /*Ѿиǵǰhole;*/
+		if(timeval_diff_ms(&l->repair_time, &now) < LEARNER_REPAIR_TIMEOUT)
+			return; 
+
+		/*ʱûκνչһacceptor*/
+		if(from == l->repair_from){
+			l->repair_acceptor = (l->repair_acceptor + 1) % peers_count(l->acceptors);
+			paxos_log_info("Repeat request for %u-%u timed out, switching to acceptor %d", 
+				l->repair_from, l->repair_to, l->repair_acceptor);
 		}
 	}
 
+	/*ֻ[from, end)ȱٵ᰸ΣѾͨĲط*/
+	l->repair_from = from;
+	do{
+		if(to > end)
+			to = end;
+		learner_send_repeat(l, from, to);
+		l->repair_to = to;
+	}while(to < end && learner_next_hole(l->state, to, &from, &to));
+
+	l->repair_time = now;
+}
+
+/*gapʱgapھ*/
+static void learner_on_gap(evutil_socket_t fd, short event, void* arg)
+{
+	iid_t from, to;
+	struct evlearner* l = (struct evlearner*)arg;
+
+	if(learner_has_holes(l->state, &from, &to) && from == l->gap_iid){
+		paxos_log_debug("Gap at iid %u persisted, repairing", from);
+		learner_repair_holes(l);
+	}
+}
+
+/*ÿackcurrent_iidǷ񱻺Ѿͨ᰸µgapһӦĶʱ*/
+static void learner_check_gap(struct evlearner* l)
+{
+	long us;
+	iid_t from, to;
+	struct timeval tv;
+
+	if(!learner_has_holes(l->state, &from, &to)){
+		if(l->gap_iid != 0){
+			l->gap_iid = 0;
+			evtimer_del(l->gap_timer);
+		}
+		return;
+	}
+
+	if(from == l->gap_iid) /*ͬһgapĶʱѾڼʱ*/
+		return;
+
+	l->gap_iid = from;
+
+	us = l->arrival_us * LEARNER_GAP_FACTOR;
+	if(us < LEARNER_GAP_MIN)
+		us = LEARNER_GAP_MIN;
+	if(us > LEARNER_GAP_MAX)
+		us = LEARNER_GAP_MAX;
+
+	tv.tv_sec = 0;
+	tv.tv_usec = us;
+	evtimer_add(l->gap_timer, &tv);
+}
+
+/*ʵرռĻƽÿʵжackackļᱻѹLEARNER_GAP_MIN
+  ֻʵرʱʱڹرյʵƽ̯*/
+static void learner_update_arrival(struct evlearner* l)
+{
+	long us;
+	iid_t closed, count;
+	struct timeval now;
+
+	closed = learner_closed_count(l->state);
+	count = closed - l->last_closed;
+	if(count == 0)
+		return;
+
+	l->last_closed = closed;
+
+	event_base_gettimeofday_cached(l->base, &now);
+	if(l->last_arrival.tv_sec != 0){
+		us = (now.tv_sec - l->last_arrival.tv_sec) * 1000000 + (now.tv_usec - l->last_arrival.tv_usec);
+		l->arrival_us = (l->arrival_us * 7 + us / (long)count) / 8;
+	}
+
+	l->last_arrival = now;
+}
+
+static void learner_check_holes(evutil_socket_t fd, short event, void* arg)
+{
+	struct evlearner* l = (struct evlearner*)arg;
+
+	learner_repair_holes(l);
+
 	/*붨ʱ*/
 	event_add(l->hole_timer, &l->tv);
 }
 
+/*learnerȡһԷ᰸Ϊмʱͬʱ˳ת*/
+static accept_ack* learner_next_delivery(struct evlearner* l)
+{
+	accept_ack* ack = learner_deliver_next(l->state);
+	if(ack != NULL && l->relay != NULL)
+		relay_forward(l->relay, ack);
+
+	return ack;
+}
+
+static void delivery_of_ack(struct paxos_delivery* d, accept_ack* ack)
+{
+	d->value = ack->value;
+	d->size = ack->value_size;
+	d->iid = ack->iid;
+	d->ballot = ack->ballot;
+	d->proposer = ack->ballot % MAX_N_OF_PROPOSERS;
+}
+
+/*Ӧõķصصغͷacks*/
+static void learner_deliver_acks(struct evlearner* l, accept_ack** acks, int n)
+{
+	int i, prop_id;
+	accept_ack* ack;
+
+	if(l->batchfun != NULL){
+		for(i = 0; i < n; i++)
+			delivery_of_ack(&l->batch[i], acks[i]);
+		l->batchfun(l->batch, n, l->delarg);
+	}
+	else{
+		for(i = 0; i < n; i++){
+			ack = acks[i];
+			/*proposer id*/
+			prop_id = ack->ballot % MAX_N_OF_PROPOSERS;
+			/*ֱֵָջֻڻصڼЧӦÿpaxos_value_ref*/
+			l->delfun(ack->value, ack->value_size, ack->iid, ack->ballot, prop_id, l->delarg);
+		}
+	}
+
+	for(i = 0; i < n; i++)
+		accept_ack_unref(acks[i]);
+}
+
+/*ͨ᰸max_batch*/
+static void learner_deliver_batch(struct evlearner* l)
+{
+	int n;
+	accept_ack* ack;
+
+	do{
+		for(n = 0; n < l->max_batch && (ack = learner_next_delivery(l)) != NULL; n++)
+			l->batch_acks[n] = ack;
+
+		if(n > 0)
+			learner_deliver_acks(l, l->batch_acks, n);
+	}while(n == l->max_batch);
+}
+
+/*̵߳ȴµ᰸0ʾ߳Ӧ˳*/
+static int learner_wait_deliver(struct evlearner* l)
+{
+	int run;
+
+	pthread_mutex_lock(&l->deliver_mutex);
+	__atomic_store_n(&l->deliver_waiting, 1, __ATOMIC_SEQ_CST);
+	/*ȴټУlearner_wake_deliverԣᶪʧ*/
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	while(spsc_ring_count(l->deliver_ring) == 0 && !l->deliver_stop)
+		pthread_cond_wait(&l->deliver_cond, &l->deliver_mutex);
+	__atomic_store_n(&l->deliver_waiting, 0, __ATOMIC_RELAXED);
+	/*˳ǰѶʣµ᰸*/
+	run = !l->deliver_stop || spsc_ring_count(l->deliver_ring) > 0;
+	pthread_mutex_unlock(&l->deliver_mutex);
+
+	return run;
+}
+
+static void learner_wake_deliver(struct evlearner* l)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&l->deliver_waiting, __ATOMIC_RELAXED)){
+		pthread_mutex_lock(&l->deliver_mutex);
+		pthread_cond_signal(&l->deliver_cond);
+		pthread_mutex_unlock(&l->deliver_mutex);
+	}
+}
+
+/*̣߳deliver_ringȡ᰸Ӧûص*/
+static void* learner_deliver_thread(void* arg)
+{
+	int n;
+	accept_ack* ack;
+	struct evlearner* l = arg;
+
+	for(;;){
+		for(n = 0; n < l->max_batch && (ack = spsc_ring_pop(l->deliver_ring)) != NULL; n++)
+			l->batch_acks[n] = ack;
+
+		if(n > 0)
+			learner_deliver_acks(l, l->batch_acks, n);
+		else if(!learner_wait_deliver(l))
+			break;
+	}
+
+	return NULL;
+}
+
+/*pullģʽ֪ͨӦöµ᰸Ӧȡնʱ*/
+static void learner_notify_pull(struct evlearner* l)
+{
+	uint64_t one = 1;
+	if(write(l->notify_fd, &one, sizeof(one)) != sizeof(one))
+		paxos_log_error("Failed to notify the learner application: %s", strerror(errno));
+}
+
+/*̰߳ͨ᰸˳ŽУ˾ͣȡacceptorϢ
+  ûŽȥ᰸learnerĴpullģʽӦȡҲͬķѹ*/
+static void learner_deliver_to_queue(struct evlearner* l)
+{
+	int n = 0;
+	accept_ack* ack;
+	struct timeval tv = {0, LEARNER_RESUME_CHECK};
+
+	while(spsc_ring_count(l->deliver_ring) < spsc_ring_size(l->deliver_ring)
+		&& (ack = learner_next_delivery(l)) != NULL){
+		spsc_ring_push(l->deliver_ring, ack);
+		n++;
+	}
+
+	if(n > 0 && !l->pull)
+		learner_wake_deliver(l);
+	else if(n > 0)
+		learner_notify_pull(l);
+
+	if(spsc_ring_count(l->deliver_ring) == spsc_ring_size(l->deliver_ring) && !l->reads_paused){
+		paxos_log_debug("Delivery queue full, pausing reads");
+		peers_suspend_read(l->acceptors);
+		mcast_suspend_read(l->mcast);
+		l->reads_paused = 1;
+		event_add(l->resume_timer, &tv);
+	}
+}
+
+/*нһºָȡ*/
+static void learner_check_resume(evutil_socket_t fd, short event, void* arg)
+{
+	struct evlearner* l = arg;
+	struct timeval tv = {0, LEARNER_RESUME_CHECK};
+
+	if(spsc_ring_count(l->deliver_ring) > spsc_ring_size(l->deliver_ring) / 2){
+		event_add(l->resume_timer, &tv);
+		return;
+	}
+
+	l->reads_paused = 0;
+	peers_resume_read(l->acceptors);
+	mcast_resume_read(l->mcast);
+	/*ѹ᰸ȷŽУٴͣ*/
+	learner_deliver_to_queue(l);
+}
+
 static void learner_deliver_next_closed(struct evlearner* l)
 {
-	int prop_id;
 	accept_ack* ack;
-	while((ack = learner_deliver_next(l->state)) != NULL){
-		/*proposer id*/
-		prop_id = ack->ballot % MAX_N_OF_PROPOSERS;
-		l->delfun(ack->value, ack->value_size, ack->iid, ack->ballot, prop_id, l->delarg);
 
-		free(ack);
+	if(l->deliver_ring != NULL){
+		if(!l->reads_paused)
+			learner_deliver_to_queue(l);
+		return;
+	}
+
+	if(l->batchfun != NULL){
+		learner_deliver_batch(l);
+		return;
 	}
+
+	while((ack = learner_next_delivery(l)) != NULL)
+		learner_deliver_acks(l, &ack, 1);
 }
 
 static void learner_handle_accept_ack(struct evlearner* l, accept_ack * aa)
 {
 	/*accept ack*/
 	learner_receive_accept(l->state, aa);
-
-	/*ǷпԷ᰸*/
-	learner_deliver_next_closed(l);
 }
 
-static void learner_handle_msg(struct evlearn* l, struct bufferevent* bev)
+/*acceptorϽֵܹ᰸ţָʱȱٵһ
+  max_iidproposerǰprepare᰸Щ᰸ûֵطΪĿ*/
+static void learner_handle_max_iid_ack(struct evlearner* l, max_iid_ack* ack)
 {
-	paxos_msg msg;
-	struct evbuffer* in;
-	char* buffer = NULL;
+	paxos_log_debug("Acceptor %d max accepted iid %u", ack->acceptor_id, ack->accepted_iid);
+	learner_catch_up(l->state, ack->accepted_iid);
+	learner_repair_holes(l);
+}
 
-	/*Ϣͷ*/
-	in = bufferevent_get_input(bev);
-	evbuffer_remove(in, &msg, sizeof(paxos_msg));
+/*proposerֵתɴüack棬ֻһֵ*/
+static void learner_handle_value(struct evlearner* l, accept_req* ar, size_t size)
+{
+	accept_ack* ack;
 
-	/*Ϣ*/
-	if(msg.data_size > 0){
-		buffer = (char *)malloc(msg.data_size);
-		evbuffer_remove(in, buffer, msg.data_size);
+	if(ACCEPT_REQ_SIZE(ar) != size){
+		paxos_log_error("Invalid accept req size %u", (unsigned)size);
+		return;
 	}
 
-	switch(msg.type){
+	ack = accept_ack_alloc(ACCEPT_ACK_SIZE(ar));
+	ack->acceptor_id = 0;
+	ack->iid = ar->iid;
+	ack->ballot = ar->ballot;
+	ack->value_ballot = ar->ballot;
+	ack->is_final = 0;
+	ack->value_size = ar->value_size;
+	memcpy(ack->value, ar->value, ar->value_size);
+
+	learner_receive_value(l->state, ack);
+	accept_ack_unref(ack);
+}
+
+/*buffer뻺ԭصϢ壬ɵ߶*/
+static void learner_handle_msg(struct evlearner* l, paxos_msg* msg, char* buffer)
+{
+	max_iid_ack mack;
+	chosen_msg cm;
+
+	switch(msg->type){
 	case accept_acks: 
+		/*ԭشlearnerֻҪһµֵʱŸ*/
+		if(msg->data_size < sizeof(accept_ack) || ACCEPT_ACK_SIZE(((accept_ack*)buffer)) != msg->data_size){
+			paxos_log_error("Invalid accept ack size %u", (unsigned)msg->data_size);
+			break;
+		}
 		learner_handle_accept_ack(l, (accept_ack*)buffer);
 		break;
 
+	case max_iid_acks:
+		if(msg->data_size != sizeof(max_iid_ack)){
+			paxos_log_error("Invalid max iid ack size %u", (unsigned)msg->data_size);
+			break;
+		}
+		memcpy(&mack, buffer, sizeof(max_iid_ack));
+		learner_handle_max_iid_ack(l, &mack);
+		break;
+
+	case accept_reqs:
+		if(msg->data_size < sizeof(accept_req)){
+			paxos_log_error("Invalid accept req size %u", (unsigned)msg->data_size);
+			break;
+		}
+		learner_handle_value(l, (accept_req*)buffer, msg->data_size);
+		break;
+
+	case credit_msgs: /*acceptorproposerĶȣlearnerҪ*/
+		break;
+
+	case chosen_msgs:
+		if(msg->data_size != sizeof(chosen_msg)){
+			paxos_log_error("Invalid chosen msg size %u", (unsigned)msg->data_size);
+			break;
+		}
+		memcpy(&cm, buffer, sizeof(chosen_msg));
+		learner_receive_chosen(l->state, cm.iid, cm.ballot);
+		break;
+
 	default:
-		paxos_log_error("Unknow msg type %d not handled", msg.type);
+		paxos_log_error("Unknow msg type %d not handled", msg->type);
 	}
+}
 
-	if(buffer != NULL)
-		free(buffer);
+static void learner_dispatch_msg(paxos_msg* msg, void* body, void* arg)
+{
+	learner_handle_msg((struct evlearner*)arg, msg, body);
 }
 
-static void on_acceptor_msg(struct bufferevent* bev, void* arg)
+static void learner_on_input(struct evbuffer* in, void* arg)
 {
-	size_t len;
-	paxos_msg msg;
 	struct evlearner* l = arg;
-	struct evbuffer* in = bufferevent_get_input(bev);
 
-	/*Ϣѭ*/
-	while ((len = evbuffer_get_length(in)) > sizeof(paxos_msg)) {
-		evbuffer_copyout(in, &msg, sizeof(paxos_msg));
-		if (len >= PAXOS_MSG_SIZE((&msg))) /*Ϣ*/
-			learner_handle_msg(l, bev); /*Ϣ*/
-	}
+	/*мתϲ*/
+	sendbuf_cork();
+
+	/*ϢѭܣŷеϢ*/
+	recvbuf_dispatch(in, learner_dispatch_msg, l);
+
+	/*ζϢرʵŸ¹رռ*/
+	learner_update_arrival(l);
+
+	/*ζackȫٷͨ᰸һ*/
+	learner_deliver_next_closed(l);
+
+	/*Ƿµgap*/
+	learner_check_gap(l);
+
+	sendbuf_uncork();
+}
+
+static void on_acceptor_msg(struct bufferevent* bev, void* arg)
+{
+	learner_on_input(bufferevent_get_input(bev), arg);
 }
 
-/*ļϢһevlearner*/
-static struct evlearner* evlearner_init_conf(struct evpaxos_config* c, deliver_function f, void* arg, struct event_base* b)
+/*̺߳(̻߳pullӦ)֮Ķ*/
+static void evlearner_init_queue(struct evlearner* l)
 {
+	l->deliver_ring = spsc_ring_new(paxos_config.learner_delivery_queue);
+	l->deliver_waiting = 0;
+	l->deliver_stop = 0;
+	l->reads_paused = 0;
+	l->resume_timer = evtimer_new(l->base, learner_check_resume, l);
+}
+
+static void evlearner_free_queue(struct evlearner* l)
+{
+	accept_ack* ack;
+
+	/*pullģʽӦûȡߵ᰸*/
+	while((ack = spsc_ring_pop(l->deliver_ring)) != NULL)
+		accept_ack_unref(ack);
+
+	event_free(l->resume_timer);
+	spsc_ring_free(l->deliver_ring);
+	if(l->notify_fd >= 0)
+		close(l->notify_fd);
+}
+
+static void evlearner_start_thread(struct evlearner* l)
+{
+	if(l->max_batch == 0)
+		l->max_batch = LEARNER_THREAD_BATCH;
+	if(l->batch_acks == NULL)
+		l->batch_acks = (accept_ack**)malloc(sizeof(accept_ack*) * l->max_batch);
+
+	evlearner_init_queue(l);
+	pthread_mutex_init(&l->deliver_mutex, NULL);
+	pthread_cond_init(&l->deliver_cond, NULL);
+	pthread_create(&l->deliver_thread, NULL, learner_deliver_thread, l);
+
+	paxos_log_info("Learner delivering on a separate thread, queue size %d", spsc_ring_size(l->deliver_ring));
+}
+
+static void evlearner_stop_thread(struct evlearner* l)
+{
+	pthread_mutex_lock(&l->deliver_mutex);
+	l->deliver_stop = 1;
+	pthread_cond_signal(&l->deliver_cond);
+	pthread_mutex_unlock(&l->deliver_mutex);
+	/*̻߳ȰѶ᰸*/
+	pthread_join(l->deliver_thread, NULL);
+
+	pthread_mutex_destroy(&l->deliver_mutex);
+	pthread_cond_destroy(&l->deliver_cond);
+}
+
+/*ļϢһevlearnerbatchfunΪNULLʱ
+  relay_id >= 0ʱΪмУlearner-relayѡǷӵм*/
+static struct evlearner* evlearner_init_conf(struct evpaxos_config* c, deliver_function f, deliver_batch_function batchfun, 
+											 int max_batch, int relay_id, void* arg, struct event_base* b)
+{
+	int i;
 	struct evlearner* l;
+	struct transport_addr addr;
+	int upstream = -1;
 	/*ȡacceptorĸ*/
 	int acceptor_count = evpaxos_acceptor_count(c);
 
-	l = (struct evlearner*)malloc(sizeof(struct evlearner*));
+	if(relay_id >= evpaxos_relay_count(c)){
+		paxos_log_error("Invalid relay id: %d", relay_id);
+		return NULL;
+	}
+
+	/*мԼֱacceptors*/
+	if(relay_id < 0 && paxos_config.learner_relay >= 0){
+		if(paxos_config.learner_relay < evpaxos_relay_count(c))
+			upstream = paxos_config.learner_relay;
+		else
+			paxos_log_error("Invalid learner relay %d, connecting to acceptors", paxos_config.learner_relay);
+	}
+
+	l = (struct evlearner*)malloc(sizeof(struct evlearner));
 	l->delfun = f;
 	l->delarg = arg;
+	l->batchfun = batchfun;
+	l->max_batch = max_batch;
+	l->batch = NULL;
+	l->batch_acks = NULL;
+	if(batchfun != NULL){
+		l->batch = (struct paxos_delivery*)malloc(sizeof(struct paxos_delivery) * max_batch);
+		l->batch_acks = (accept_ack**)malloc(sizeof(accept_ack*) * max_batch);
+	}
+	l->deliver_ring = NULL;
+	l->pull = 0;
+	l->notify_fd = -1;
+	l->base = b;
+	l->repair_acceptor = 0;
+	l->repair_from = 0;
+	l->repair_to = 0;
+	l->gap_iid = 0;
+	l->arrival_us = 0;
+	l->last_arrival.tv_sec = 0;
+	l->last_arrival.tv_usec = 0;
+	l->last_closed = 0;
 	l->state = learner_new(acceptor_count);
 	/*һacceptorӹ*/
-	l->acceptors = peers_new(b);
-	/*acceptor*/
-	peers_connect_to_acceptors(l->acceptors, c, on_acceptor_msg, l);
+	l->acceptors = peers_new(b, role_learner, 0);
+	if(upstream >= 0){
+		/*ӵм̣м̷ĶѾͨ᰸Ҳм*/
+		addr = evpaxos_relay_address(c, upstream);
+		peers_connect(l->acceptors, &addr, on_acceptor_msg, l);
+		paxos_log_info("Learner subscribing to relay %d", upstream);
+	}
+	else{
+		/*acceptor*/
+		peers_connect_to_acceptors(l->acceptors, c, on_acceptor_msg, l);
+	}
+
+	/*chosen-broadcastģʽacceptorsٹ㲥ackproposersģֵ鲥proposersõacceptorsֻڲ*/
+	l->proposers = NULL;
+	if(upstream < 0 && paxos_config.chosen_broadcast){
+		/*ʱpeer_hellolearnerɫproposerݴ˷ֵchosenϢ*/
+		l->proposers = peers_new(b, role_learner, 0);
+		for(i = 0; i < evpaxos_proposer_count(c); i++){
+			addr = evpaxos_proposer_address(c, i);
+			peers_connect(l->proposers, &addr, on_acceptor_msg, l);
+		}
+	}
+
+	/*ֱacceptorsʱ鲥accept ackschosen-broadcastģʽacksֵΪproposer鲥accept reqsõֵ*/
+	l->mcast = NULL;
+	if(upstream < 0)
+		l->mcast = mcast_new(b, paxos_config.chosen_broadcast ? mcast_accept_reqs : mcast_accept_acks, learner_on_input, l);
+
+	l->relay = NULL;
+	if(relay_id >= 0){
+		addr = evpaxos_relay_listen_address(c, relay_id);
+		l->relay = relay_new(b, &addr, paxos_config.learn_instances);
+	}
 
 	l->tv.tv_sec = 0;
 	l->tv.tv_usec = 100000; /*100ms*/
@@ -133,6 +652,24 @@ static struct evlearner* evlearner_init_conf(struct evpaxos_config* c, deliver_f
 	l->hole_timer = evtimer_new(b, learner_check_holes, l);
 	/*һʱ¼*/
 	event_add(l->hole_timer, &l->tv);
+	/*gapʱֻڳgapʱ*/
+	l->gap_timer = evtimer_new(b, learner_on_gap, l);
+
+	/*鲥ȴղֻܿõеֱֵʧ*/
+	if(l->mcast == NULL && upstream < 0 && paxos_config.multicast_group != NULL){
+		paxos_log_error("Learner failed to join multicast group %s", paxos_config.multicast_group);
+		evlearner_free(l);
+		return NULL;
+	}
+
+	/*ûлصpullģʽ*/
+	if(f == NULL && batchfun == NULL){
+		l->pull = 1;
+		evlearner_init_queue(l);
+		l->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+	else if(paxos_config.learner_delivery_thread)
+		evlearner_start_thread(l);
 
 	return l;
 }
@@ -142,20 +679,141 @@ struct evlearner* evlearner_init(const char* config_file, deliver_function f, vo
 	/*ȡļ*/
 	struct evpaxos_config* c = evpaxos_config_read(config_file);
 	if(c) /*ļ*/
-		return evlearner_init_conf(c, f, arg, base);
+		return evlearner_init_conf(c, f, NULL, 0, -1, arg, base);
 
 	return NULL;
 }
 
+struct evlearner* evlearner_init_batch(const char* config_file, deliver_batch_function f, int max_batch, void* arg, struct event_base* base)
+{
+	struct evpaxos_config* c;
+
+	if(max_batch <= 0){
+		paxos_log_error("Invalid max batch: %d", max_batch);
+		return NULL;
+	}
+
+	c = evpaxos_config_read(config_file);
+	if(c)
+		return evlearner_init_conf(c, NULL, f, max_batch, -1, arg, base);
+
+	return NULL;
+}
+
+/*pullģʽlearnerͨ᰸˳УӦõevlearner_next/evlearner_pollȡ*/
+struct evlearner* evlearner_init_pull(const char* config_file, struct event_base* base)
+{
+	struct evpaxos_config* c = evpaxos_config_read(config_file);
+	if(c)
+		return evlearner_init_conf(c, NULL, NULL, 0, -1, NULL, base);
+
+	return NULL;
+}
+
+/*ȡһͨ᰸ûз0ֵУpaxos_value_unref*/
+int evlearner_next(struct evlearner* l, struct paxos_delivery* d)
+{
+	return evlearner_poll(l, d, 1);
+}
+
+/*ȡmax˳ͨ᰸ȡĸȡնʱevlearner_fd֪ͨ*/
+int evlearner_poll(struct evlearner* l, struct paxos_delivery* d, int max)
+{
+	int n = 0, cleared = 0;
+	uint64_t count;
+	accept_ack* ack;
+
+	if(!l->pull)
+		return 0;
+
+	while(n < max){
+		if((ack = spsc_ring_pop(l->deliver_ring)) != NULL){
+			delivery_of_ack(&d[n++], ack);
+			continue;
+		}
+		/*֪ͨټһζУ֮Ž᰸֪ͨᶪʧ*/
+		if(cleared)
+			break;
+		if(read(l->notify_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+			paxos_log_error("Failed to read the learner eventfd: %s", strerror(errno));
+		cleared = 1;
+	}
+
+	return n;
+}
+
+/*pullģʽ᰸ȡʱɶļӦÿ԰Լ¼ѭģʽ-1*/
+int evlearner_fd(struct evlearner* l)
+{
+	return l->notify_fd;
+}
+
+/*Ϊмidһlearnerõм̶˿ϽlearnerĶ*/
+struct evlearner* evlearner_init_relay(const char* config_file, int relay_id, deliver_function f, void* arg, struct event_base* base)
+{
+	struct evpaxos_config* c = evpaxos_config_read(config_file);
+	if(c)
+		return evlearner_init_conf(c, f, NULL, 0, relay_id, arg, base);
+
+	return NULL;
+}
+
+/*Ӧ֪ѾӦõ᰸iidlearneriid + 1ʼֻacceptors֮ȱٵ᰸*/
+void evlearner_set_instance_id(struct evlearner* l, iid_t iid)
+{
+	int i;
+
+	learner_set_instance_id(l->state, iid);
+	l->repair_from = 0;
+	l->repair_to = 0;
+	l->gap_iid = 0;
+	evtimer_del(l->gap_timer);
+
+	/*ѯacceptorsϵ᰸ţõҪ*/
+	for(i = 0; i < peers_count(l->acceptors); i++){
+		struct bufferevent* bev = peers_get_buffer(l->acceptors, i);
+		if(bev != NULL)
+			sendbuf_add_max_iid_req(bev);
+	}
+
+	paxos_log_info("Learner resuming from iid %u", iid + 1);
+}
+
+void paxos_value_ref(char* value)
+{
+	accept_ack_ref(accept_ack_of_value(value));
+}
+
+void paxos_value_unref(char* value)
+{
+	accept_ack_unref(accept_ack_of_value(value));
+}
+
 void evlearner_free(struct evlearner* l)
 {
+	if(l->deliver_ring != NULL){
+		if(!l->pull)
+			evlearner_stop_thread(l);
+		evlearner_free_queue(l);
+	}
+
 	/*ͷӹ*/
+	mcast_free(l->mcast);
 	peers_free(l->acceptors);
+	if(l->proposers != NULL)
+		peers_free(l->proposers);
+	relay_free(l->relay);
 	/*ͷżholeĶʱ*/
 	event_free(l->hole_timer);
+	event_free(l->gap_timer);
 	/*ͷϢ*/
 	learner_free(l->state);
 
+	if(l->batch != NULL)
+		free(l->batch);
+	if(l->batch_acks != NULL)
+		free(l->batch_acks);
+
 	free(l);
 }
 
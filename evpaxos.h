@@ -13,17 +13,54 @@ struct evacceptor;
 struct evproposer;
 
 
-/* When starting a learner you must pass a callback to be invoked whenever a value has been learned.*/
+/* When starting a learner you must pass a callback to be invoked whenever a value has been learned.
+   The value points into the learner's receive buffer and is only valid during the callback,
+   call paxos_value_ref() to keep it and paxos_value_unref() when done with it.*/
 typedef void(*deliver_function)(char*, size_t, iid_t, ballot_t, int, void*);
 
+/* One learned value in a batch, the value follows the same borrowing rules as deliver_function.*/
+struct paxos_delivery
+{
+	char*		value;
+	size_t		size;
+	iid_t		iid;
+	ballot_t	ballot;
+	int			proposer;
+};
+
+/* Batched delivery: invoked with all consecutively closed instances available after one read from the acceptors,
+   at most max_batch at a time, so that the application can apply and sync them together.*/
+typedef void(*deliver_batch_function)(struct paxos_delivery*, int, void*);
+
 struct evlearner*	evlearner_init(const char* config_file, deliver_function f, void* arg, struct event_base* base);
+struct evlearner*	evlearner_init_batch(const char* config_file, deliver_batch_function f, int max_batch, void* arg, struct event_base* base);
+/* Pull mode: decided values are queued in order (learner-delivery-queue entries) and taken by the application with
+   evlearner_next()/evlearner_poll() from any one thread. Each returned value must be released with paxos_value_unref().
+   While the queue is full the learner stops reading from the acceptors.
+   evlearner_fd() returns a descriptor that becomes readable when values are queued, so the application can wait
+   for it instead of spinning; it is cleared when evlearner_next()/evlearner_poll() find the queue empty, so keep
+   taking values until they return fewer than asked before waiting again.*/
+struct evlearner*	evlearner_init_pull(const char* config_file, struct event_base* base);
+int					evlearner_next(struct evlearner* l, struct paxos_delivery* d);
+int					evlearner_poll(struct evlearner* l, struct paxos_delivery* d, int max);
+int					evlearner_fd(struct evlearner* l);
+
+/* A relay learner connects to the acceptors and forwards what it delivers, in order, to the learners subscribed to it
+   (config line "r <id> <address> <port>", downstream learners set "learner-relay <id>").*/
+struct evlearner*	evlearner_init_relay(const char* config_file, int relay_id, deliver_function f, void* arg, struct event_base* base);
+void				evlearner_set_instance_id(struct evlearner* l, iid_t iid);
 void				evlearner_free(struct evlearner* l);
 
+/* With acceptor-net-threads > 0 the process must call evthread_use_pthreads() before creating any event_base,
+   including b: the acceptor writes to connections owned by its network threads.*/
 struct evacceptor*  evacceptor_init(int id, const char* config, struct event_base* b);
 int					evacceptor_free(struct evacceptor* a);
 
 struct evproposer*	evproposer_init(int id, const char* config, struct event_base* b);
 void				evproposer_free(struct evproposer* p);
 
+void				paxos_value_ref(char* value);
+void				paxos_value_unref(char* value);
+
 void				paxos_submit(struct bufferevent* bev, char* value, int size);
 #endif
@@ -4,7 +4,9 @@
 #include "libpaxos_message.h"
 #include "tcp_sendbuf.h"
 #include "tcp_receiver.h"
+#include "tcp_recvbuf.h"
 #include "proposer.h"
+#include "multicast.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -21,28 +23,96 @@ struct evproposer
 	struct event_base*		base;			/*libevent base*/
 	struct proposer*		state;			/*proposer Ϣ*/
 	struct peers*			acceptors;		/*acceptorӽڵ*/
-	struct timval			tv;				/*ʱʱ*/
+	struct timeval			tv;				/*ʱʱ*/
 	struct event*			timeout_ev;		/*ʱʱ*/
+	struct mcast*			mcast_reqs;		/*鲥accept reqsû鲥ʱΪNULL*/
+	struct mcast*			mcast_acks;		/*鲥acceptorsֵaccept acksͶ*/
+	iid_t					chosen_sent;	/*ϴ֪ͨacceptorsͨ*/
+	int						chosen_count;	/*ϴ֪֮ͨͨ᰸*/
 };
 
+/*ÿͨô᰸֪ͨһacceptorsͨıţʱʱҲ֪ͨ*/
+#define PROPOSER_CHOSEN_INTERVAL	1024
+
+/*chosen-broadcastģʽ°鲥˵ֵͨpeer_helloΪlearner(м̻ݱŲµֵ)
+  learner͹acceptorһֵlearnerָ*/
+static void send_values_to_learners(struct evproposer* p, accept_req* ar)
+{
+	int i;
+	struct carray* learners = tcp_receiver_get_learners(p->receiver);
+	for(i = 0; i < carray_count(learners); i++){
+		struct bufferevent* bev = tcp_receiver_get_buffer(p->receiver, carray_at(learners, i));
+		if(bev != NULL)
+			sendbuf_add_accept_req(bev, ar);
+	}
+}
+
+static void send_chosen_to_learners(struct evproposer* p, iid_t iid, ballot_t ballot)
+{
+	int i;
+	struct carray* learners = tcp_receiver_get_learners(p->receiver);
+	for(i = 0; i < carray_count(learners); i++){
+		struct bufferevent* bev = tcp_receiver_get_buffer(p->receiver, carray_at(learners, i));
+		if(bev != NULL)
+			sendbuf_add_chosen(bev, iid, ballot);
+	}
+}
+
 /*prepare_reqеacceptorеһ׶ε*/
 static void send_prepares(struct evproposer* p, prepare_req* pr)
 {
 	int i;
 	for(i = 0; i < peers_count(p->acceptors); i ++){
 		struct bufferevent* bev = peers_get_buffer(p->acceptors, i);
-		sendbuf_add_prepare_req(bev, pr);
+		if(bev != NULL) /*acceptorʱ*/
+			sendbuf_add_prepare_req(bev, pr);
 	}
 }
 
-/*accept_reqеacceptorеڶ׶ε*/
+/*accept_reqеacceptorеڶ׶ε飬鲥ʱֻһΣݱŲµֵȻ*/
 static void send_accepts(struct evproposer* p, accept_req* ar)
 {
 	int i;
+	if(p->mcast_reqs != NULL && mcast_add_accept_req(p->mcast_reqs, ar) == 0)
+		return; /*learnersҲ*/
+
 	for(i = 0; i < peers_count(p->acceptors); i++){
 		struct bufferevent* bev = peers_get_buffer(p->acceptors, i);
-		sendbuf_add_accept_req(bev, ar);
+		if(bev != NULL)
+			sendbuf_add_accept_req(bev, ar);
 	}
+
+	if(paxos_config.chosen_broadcast)
+		send_values_to_learners(p, ar);
+}
+
+/*ӹǰеacceptorѯ᰸(phase 0)*/
+static void send_max_iid_reqs(struct evproposer* p)
+{
+	int i;
+	for(i = 0; i < peers_count(p->acceptors); i++){
+		struct bufferevent* bev = peers_get_buffer(p->acceptors, i);
+		if(bev != NULL)
+			sendbuf_add_max_iid_req(bev);
+	}
+}
+
+/*֪ͨacceptorsĸΪֹѾͨӹܵproposerָ֮*/
+static void send_chosen_upto(struct evproposer* p)
+{
+	int i;
+	iid_t iid = proposer_chosen_iid(p->state);
+
+	p->chosen_count = 0;
+	if(iid <= p->chosen_sent)
+		return;
+
+	for(i = 0; i < peers_count(p->acceptors); i++){
+		struct bufferevent* bev = peers_get_buffer(p->acceptors, i);
+		if(bev != NULL)
+			sendbuf_add_chosen_upto(bev, iid);
+	}
+	p->chosen_sent = iid;
 }
 
 static void proposer_preexecute(struct evproposer* p)
@@ -50,8 +120,16 @@ static void proposer_preexecute(struct evproposer* p)
 	int i;
 	prepare_req pr;
 
-	/*ÿԷ᰸ĸ*/
-	int count = p->preexec_window - proposer_prepared_count(p->state);
+	/*phase 0δɣ֪ĸiidʼ*/
+	if(!proposer_is_ready(p->state))
+		return;
+
+	/*ÿԷ᰸ĸacceptorĶȣʱǰprepare*/
+	int window = p->preexec_window;
+	int credit = proposer_credit(p->state);
+	if(credit < window)
+		window = credit;
+	int count = window - proposer_prepared_count(p->state);
 	for(i = 0; i < count; i ++){
 		 /*һprepare_reqϢ*/
 		proposer_prepare(p->state, &pr);
@@ -81,12 +159,25 @@ static void proposer_handle_prepare_ack(struct evproposer* p, prepare_ack* ack)
 		send_prepares(p, &pr);
 }
 
+/*proposermax iid ackĴӦʼ*/
+static void proposer_handle_max_iid_ack(struct evproposer* p, max_iid_ack* ack)
+{
+	proposer_receive_max_iid_ack(p->state, ack);
+}
+
 /*proposeraccept ackĴӦ*/
 static void proposer_handle_accept_ack(struct evproposer* p, accept_ack* ack)
 {
+	int chosen;
 	prepare_req pr;
-	if (proposer_receive_accept_ack(p->state, ack, &pr))/*accept ackӦжϷֵǷҪ·һ׶*/
+	if (proposer_receive_accept_ack(p->state, ack, &pr, &chosen))/*accept ackӦжϷֵǷҪ·һ׶*/
 		send_prepares(p, &pr);
+	else if (chosen){
+		if(paxos_config.chosen_broadcast)
+			send_chosen_to_learners(p, ack->iid, ack->ballot);
+		if(++p->chosen_count >= PROPOSER_CHOSEN_INTERVAL)
+			send_chosen_upto(p);
+	}
 }
 
 /*Կͻ˵ϢϢתΪȴ*/
@@ -96,72 +187,89 @@ static void proposer_handle_client_msg(struct evproposer* p, char* value, int si
 }
 
 /*proposerϢӿ*/
-static void proposer_handle_msg(struct evproposer* p, struct bufferevent* bev)
+/*buffer뻺ԭصϢ壬Żᶪ*/
+static void proposer_handle_msg(struct evproposer* p, paxos_msg* msg, char* buffer)
 {
-	paxos_msg msg;
-	struct evbuffer* in;
-	char* buffer = NULL;
-
-	/*Ϣͷ*/
-	in = bufferevent_get_input(bev);
-	evbuffer_remove(in, &msg, sizeof(paxos_msg));
-
-	/*Ϣ*/
-	if (msg.data_size > 0) {
-		buffer = malloc(msg.data_size);
-		evbuffer_remove(in, buffer, msg.data_size);
-	}
-
 	/*Ϣ*/
-	switch (msg.type){
+	switch (msg->type){
 	case prepare_acks:
 		proposer_handle_prepare_ack(p, (prepare_ack*)buffer);
 		break;
 	case accept_acks:
 		proposer_handle_accept_ack(p, (accept_ack*)buffer);
 		break;
+	case max_iid_acks:
+		proposer_handle_max_iid_ack(p, (max_iid_ack*)buffer);
+		break;
+	case credit_msgs:
+		proposer_receive_credit(p->state, (credit_msg*)buffer);
+		break;
 	case submit:
-		proposer_handle_client_msg(p, buffer, msg.data_size);
+		proposer_handle_client_msg(p, buffer, msg->data_size);
 		break;
 	default:
-		paxos_log_error("Unknow msg type %d not handled", msg.type);
+		paxos_log_error("Unknow msg type %d not handled", msg->type);
 		return;
 	}
 
 	/*Էĵڶ׶,׶Լ*/
 	try_accept(p);
+}
+
+static void handle_msg(paxos_msg* msg, void* body, void* arg)
+{
+	proposer_handle_msg((struct evproposer*)arg, msg, body);
+}
 
-	if (buffer != NULL)
-		free(buffer);
+static void handle_input(struct evbuffer* in, void* arg)
+{
+	/*ȡϢѭȡֹճзÿacceptorϢϲ*/
+	sendbuf_cork();
+	recvbuf_dispatch(in, handle_msg, arg);
+	sendbuf_uncork();
 }
 
+/*acceptors*/
 static void handle_request(struct bufferevent* bev, void* arg)
 {
-	size_t len;
-	paxos_msg msg;
-	struct evproposer* p = (struct evproposer*)arg;
-
-	struct evbuffer* in = bufferevent_get_input(bev);
-
-	/*ȡϢѭȡֹճ*/
-	while ((len = evbuffer_get_length(in)) > sizeof(paxos_msg)){
-		evbuffer_copyout(in, &msg, sizeof(paxos_msg));
-		
-		if(len >= PAXOS_MSG_SIZE((&msg))){
-			proposer_handle_msg(p, bev);
-		}
-	}
+	handle_input(bufferevent_get_input(bev), arg);
+}
+
+/*ͻ˺learnersӣreceiverѾcork*/
+static void handle_client_msg(struct bufferevent* bev, paxos_msg* msg, void* body, void* arg)
+{
+	proposer_handle_msg((struct evproposer*)arg, msg, body);
 }
 
 /*鳬ʱ᰸*/
 static void proposer_check_timeouts(evutil_socket_t fd, short event, void* arg)
 {
+	int i;
 	struct evproposer* p = arg;
-	struct timeout_iterator* iter = proposer_timeout_iterator(p->state);
+	struct timeout_iterator* iter;
+
+	/*phase 0Ӧδ²ѯ*/
+	if(!proposer_is_ready(p->state)){
+		send_max_iid_reqs(p);
+		event_add(p->timeout_ev, &p->tv);
+		return;
+	}
+
+	/*еͳ*/
+	for(i = 0; i < peers_count(p->acceptors); i++){
+		struct peer_stats s;
+		peers_get_stats(p->acceptors, i, &s);
+		paxos_log_debug("Acceptor %d queued %u max %u dropped %lu disconnects %lu lost %u%s", i, (unsigned)s.queued, 
+			(unsigned)s.max_queued, s.dropped, s.disconnects, (unsigned)s.lost_bytes, s.slow ? " (slow)" : "");
+	}
+
+	iter = proposer_timeout_iterator(p->state);
+	sendbuf_cork();
+	send_chosen_upto(p);
 
 	/*һ׶γʱ᰸*/
 	prepare_req* pr;
-	while((pr == timeout_iterator_prepare(iter)) != NULL){ /*ȡʱ᰸(һ׶)*/
+	while((pr = timeout_iterator_prepare(iter)) != NULL){ /*ȡʱ᰸(һ׶)*/
 		paxos_log_info("Instance %d timed out.", pr->iid);
 		/*Գʱ᰸·*/
 		send_prepares(p, pr);
@@ -175,6 +283,7 @@ static void proposer_check_timeouts(evutil_socket_t fd, short event, void* arg)
 		free(ar);
 	}
 
+	sendbuf_uncork();
 	/*ͷųʱĵ*/
 	timeout_iterator_free(iter);
 	/*һʱ*/
@@ -184,7 +293,8 @@ static void proposer_check_timeouts(evutil_socket_t fd, short event, void* arg)
 /*һproposer󣬲*/
 struct evproposer* evproposer_init(int id, const char* config, struct event_base* b)
 {
-	int port, acceptor_count;
+	int acceptor_count;
+	struct transport_addr addr;
 	struct evproposer* p;
 
 	/*ȡļ*/
@@ -198,8 +308,8 @@ struct evproposer* evproposer_init(int id, const char* config, struct event_base
 		return NULL;
 	}
 
-	/*ȡproposerļ˿*/
-	port = evpaxos_proposer_listen_port(conf, id);
+	/*ȡproposerļַ*/
+	addr = evpaxos_proposer_listen_address(conf, id);
 	/*ȡacceptor*/
 	acceptor_count = evpaxos_acceptor_count(conf);
 
@@ -209,12 +319,27 @@ struct evproposer* evproposer_init(int id, const char* config, struct event_base
 
 	/*ͬʱύ鰸*/
 	p->preexec_window = paxos_config.proposer_preexec_window;
+	p->chosen_sent = 0;
+	p->chosen_count = 0;
+
+	/*鲥accept reqsacceptorsӦproposers鲥յշlearnersֵӽʧʱûбҪͷ*/
+	p->mcast_reqs = mcast_new(b, mcast_accept_reqs, NULL, NULL);
+	p->mcast_acks = NULL;
+	if(p->mcast_reqs != NULL)
+		p->mcast_acks = mcast_new(b, mcast_proposer_acks, handle_input, p);
+	if(paxos_config.multicast_group != NULL && p->mcast_acks == NULL){
+		paxos_log_error("Proposer %d failed to join multicast group %s", id, paxos_config.multicast_group);
+		mcast_free(p->mcast_reqs);
+		evpaxos_config_free(conf);
+		free(p);
+		return NULL;
+	}
 	
 	/*һϢ*/
-	p->receiver = tcp_receiver_new(b, port, handle_request, p);
+	p->receiver = tcp_receiver_new(b, &addr, handle_client_msg, p);
 	
 	/*һacceptorĹ*/
-	p->acceptors = peers_new(b);
+	p->acceptors = peers_new(b, role_proposer, id);
 	/*ÿacceptor*/
 	peers_connect_to_acceptors(p->acceptors, conf, handle_request, p);
 	
@@ -228,8 +353,8 @@ struct evproposer* evproposer_init(int id, const char* config, struct event_base
 	/*һproposer Ϣ*/
 	p->state = proposer_new(p->id, acceptor_count);
 
-	/*ִ̽prepare(᰸һ׶)*/
-	proposer_preexecute(p);
+	/*Ȳѯacceptorsϵ᰸ţӦִprepare(᰸һ׶)*/
+	send_max_iid_reqs(p);
 
 	evpaxos_config_free(conf);
 
@@ -237,7 +362,7 @@ struct evproposer* evproposer_init(int id, const char* config, struct event_base
 }
 
 /*ͷevproposer*/
-void proposer_free(struct evproposer* p)
+void evproposer_free(struct evproposer* p)
 {
 	if(p != NULL){
 		if(p->state != NULL)
@@ -249,6 +374,11 @@ void proposer_free(struct evproposer* p)
 		if(p->receiver != NULL)
 			tcp_receiver_free(p->receiver);
 
+		if(p->timeout_ev != NULL)
+			event_free(p->timeout_ev);
+
+		mcast_free(p->mcast_reqs);
+		mcast_free(p->mcast_acks);
 		free(p);
 	}
 }
@@ -1,28 +1,69 @@
 #include "learner.h"
-#include "khash.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 #include <assert.h>
 
+/*accept_ack_allocĻͷackں*/
+struct accept_ack_buf
+{
+	int				refs;
+	accept_ack		ack;
+};
+
+/*ʵĳballotٸacceptor*/
+struct ballot_count
+{
+	ballot_t		ballot;
+	int				count;
+};
+
+/*һacceptorʵһackԪݣֵ*/
+struct acceptor_ack
+{
+	ballot_t		ballot;					/*0ʾûյacceptorack*/
+	ballot_t		value_ballot;
+};
+
+/*ʵϵһֵͬһvalue_ballotֵֻһݣacceptor*/
+struct instance_value
+{
+	ballot_t		value_ballot;
+	int				refs;
+	accept_ack*		ack;
+};
+
 /*һʵ*/
 struct instance
 {
-	iid_t			iid;					/*᰸ţȫΨһ*/
+	iid_t			iid;					/*᰸ţȫΨһ0ʾղ*/
 	ballot_t		last_update_ballot;
-	accept_ack**	acks;					/*еack*/
-	accept_ack*		final_value;			/*ͨack*/
+	int				closed;					/*Ѿ֮ͨackֱӶ*/
+	int				nballots;				/*ballotsЧļ*/
+	struct ballot_count* ballots;			/*ballotͳƵackÿacceptorֻһΣacceptors*/
+	int				nvalues;				/*valuesЧֵ*/
+	struct instance_value* values;			/*value_ballotȥصֵacceptors*/
+	struct acceptor_ack* acks;				/*ÿacceptorackԪݣָlearnerԤack*/
+	accept_ack*		final_value;			/*ͨack, ָvaluesеֵproposed*/
+	accept_ack*		proposed;				/*chosen-broadcastģʽproposerֵballotΪballot*/
+	ballot_t		chosen_ballot;			/*proposer֪ͨѾͨballotֵܻû0ʾû*/
 };
 
-/*һinstanceHASH MAP*/
-KHASH_MAP_INIT_INT(instance, struct instance*);
-
 struct learner
 {
 	int				acceptors;				/*ȷacceptorĸ*/
 	int				late_start;				/*ǷҪͬ״̬Ϣiid*/
 	iid_t			current_iid;			/*ǰľID*/
 	iid_t			highest_iid_closed;		/*Ϊͨţiid*/
-	khash_t(instance)* instances;
-}; 
+	iid_t			catch_up_iid;			/*acceptors֪᰸ţָʱΪֹҪ*/
+	iid_t			window;					/*ʵڴС(learn_instances)ֻ[current_iid, current_iid + window)ack*/
+	struct instance* instances;				/*iid % windowĻʵ*/
+	struct acceptor_ack* acks;				/*ʵackۣÿʵacceptors*/
+	struct ballot_count* ballots;			/*ʵballotۣÿʵacceptors*/
+	struct instance_value* values;			/*ʵֵۣÿʵacceptors*/
+	uint64_t*		closed;					/*iid % windowͨδʵλͼ64λɨholes*/
+	iid_t			closed_count;			/*ۼƹرյʵֻƺֵȻȷ*/
+};
 
 static struct instance* learner_get_instance(struct learner* l, iid_t iid);
 static struct instance* learner_get_current_instance(struct learner* l);
@@ -30,39 +71,69 @@ static struct instance* learner_get_instance_or_create(struct learner* l, iid_t
 
 static void				learner_delete_instance(struct learner* l, struct instance* inst);
 
-static struct instance* instance_new(int acceptors);
-static void				instance_free(struct instance* i, int acceptors);
+static void				instance_clear(struct instance* i, int acceptors);
 
 static void				instance_update(struct instance* i, accept_ack* ack, int acceptors);
-static int				instance_has_quorum(struct instance* i, int acceptors);
+static int				instance_has_quorum(struct instance* i);
+static int				instance_count_ballot(struct instance* i, ballot_t ballot, int delta);
 static void				instance_add_accept(struct instance* i, accept_ack* ack);
-
-static accept_ack*		accept_ack_dup(accept_ack* ack);
+static accept_ack*		instance_retain_value(struct instance* i, accept_ack* ack);
+static void				instance_release_value(struct instance* i, ballot_t value_ballot);
+static accept_ack*		instance_take_value(struct instance* i, accept_ack* value);
+static void				instance_check_chosen(struct instance* i);
+static struct instance*	learner_get_instance_for(struct learner* l, iid_t iid);
+static void				learner_update_closed(struct learner* l, struct instance* inst);
+static iid_t			learner_scan_closed(struct learner* l, iid_t from, iid_t limit, int closed);
+static iid_t			learner_hole_limit(struct learner* l);
 
 struct learner* learner_new(int acceptors)
 {
+	iid_t i;
 	struct learner* l = (struct learner*)malloc(sizeof(struct learner));
 	l->acceptors = acceptors;
 	l->current_iid = 1;
 	l->highest_iid_closed = 1;
+	l->catch_up_iid = 0;
+	l->closed_count = 0;
 	l->late_start = !paxos_config.learner_catch_up;
-	l->instances = kh_init(instance);
+
+	l->window = paxos_config.learn_instances > 0 ? paxos_config.learn_instances : 2048;
+	/*ȡ64ıλͼֱ߽iid64һ£ɨʱôֵĻ*/
+	l->window = (l->window + 63) / 64 * 64;
+	/*һԷڵʵackۣ֮Ĳҡͷٷʵ*/
+	l->instances = (struct instance*)calloc(l->window, sizeof(struct instance));
+	l->acks = (struct acceptor_ack*)calloc(l->window * acceptors, sizeof(struct acceptor_ack));
+	l->ballots = (struct ballot_count*)calloc(l->window * acceptors, sizeof(struct ballot_count));
+	l->values = (struct instance_value*)calloc(l->window * acceptors, sizeof(struct instance_value));
+	l->closed = (uint64_t*)calloc(l->window / 64, sizeof(uint64_t));
+	assert(l->instances != NULL && l->acks != NULL && l->ballots != NULL && l->values != NULL && l->closed != NULL);
+
+	for(i = 0; i < l->window; i++){
+		l->instances[i].acks = l->acks + i * acceptors;
+		l->instances[i].ballots = l->ballots + i * acceptors;
+		l->instances[i].values = l->values + i * acceptors;
+	}
 
 	return l;
 }
 
 void learner_free(struct learner* l)
 {
-	struct instance* inst;
+	iid_t i;
 	/*ɾеʵ*/
-	kh_foreach_value(l->instances, inst, instance_free(inst, l->acceptors));
-	/*ͷhash map*/
-	kh_destroy(instance, l->instances);
+	for(i = 0; i < l->window; i++)
+		instance_clear(&l->instances[i], l->acceptors);
+
+	free(l->instances);
+	free(l->acks);
+	free(l->ballots);
+	free(l->values);
+	free(l->closed);
 	free(l);
 }
 
-/*һacceptoraccept ack¼*/
-void learner_recevie_accept(struct learner* l, accept_ack* ack)
+/*һacceptoraccept ack¼ackֱָջҪһµֵʱlearnerŸ*/
+void learner_receive_accept(struct learner* l, accept_ack* ack)
 {
 	/*ǵһaccept ack,ҪϢΪʼֵ,൱ν*/
 	if(l->late_start){
@@ -78,17 +149,55 @@ void learner_recevie_accept(struct learner* l, accept_ack* ack)
 
 	/*ͨack iidһ߹instance,ûҵͻṹһ*/
 	struct instance* inst = learner_get_instance_or_create(l, ack->iid);
+	if(inst == NULL){ /*ʵڣ֮holes»ȡţ򴰿hole֪Ҫ*/
+		paxos_log_debug("Dropped accept_ack for iid %u. Out of window.", ack->iid);
+		learner_catch_up(l, ack->iid);
+		return ;
+	}
 
 	/*ܵack¼״̬뵽instance*/
 	instance_update(inst, ack, l->acceptors);
+	/*ʱacceptorطֵҲproposerchosenϢرʵ*/
+	if(!inst->closed)
+		instance_check_chosen(inst);
+	learner_update_closed(l, inst);
+}
 
-	/*ѾǴʵiidѾأΪͨiid,highest iidֵ*/
-	if(instance_has_quorum(inst, l->acceptors) && (inst->iid > l->highest_iid_closed)){
-		l->highest_iid_closed = inst->iid;
+/*chosen-broadcastģʽproposerֵ(ack->ballotΪballot)ֻ棬*/
+void learner_receive_value(struct learner* l, accept_ack* ack)
+{
+	struct instance* inst = learner_get_instance_for(l, ack->iid);
+	if(inst == NULL || inst->closed)
+		return;
+
+	/*ͬһʵֻballotֵ*/
+	if(inst->proposed != NULL){
+		if(inst->proposed->ballot >= ack->ballot)
+			return;
+		accept_ack_unref(inst->proposed);
 	}
+
+	accept_ack_ref(ack);
+	inst->proposed = ack;
+
+	instance_check_chosen(inst);
+	learner_update_closed(l, inst);
+}
+
+/*proposer֪ͨʵballotѾacceptorܣֵ˾͹رʵ*/
+void learner_receive_chosen(struct learner* l, iid_t iid, ballot_t ballot)
+{
+	struct instance* inst = learner_get_instance_for(l, iid);
+	if(inst == NULL || inst->closed)
+		return;
+
+	inst->chosen_ballot = ballot;
+
+	instance_check_chosen(inst);
+	learner_update_closed(l, inst);
 }
 
-/*һ᰸*/
+/*һ᰸صackһãaccept_ack_unrefͷ*/
 accept_ack* learner_deliver_next(struct learner* l)
 {
 	struct instance* inst = learner_get_current_instance(l);
@@ -96,98 +205,221 @@ accept_ack* learner_deliver_next(struct learner* l)
 		return NULL;
 
 	/*᰸ͨ,᰸*/
-	if(instance_has_quorum(inst, l->acceptors)){
-		/*һaccept ackΪͨϢ*/
-		accept_ack* ack = accept_ack_dup(inst->final_value);
+	if(instance_has_quorum(inst)){
+		/*ֱӰֵͨΪͨϢ壬ٸ*/
+		accept_ack* ack = instance_take_value(inst, inst->final_value);
 		/*ɾ᰸ʵ*/
 		learner_delete_instance(l, inst);
 
 		l->current_iid ++;/*++,Ԥһ᰸*/
+		return ack;
 	}
+
+	return NULL;
+}
+
+/*һûͨ᰸[from, to)*/
+/*ĿǰΪֹرյʵͳʵ֮Ĺرռ*/
+iid_t learner_closed_count(struct learner* l)
+{
+	return l->closed_count;
 }
 
-int learner_has_holes(struct learner* l, iid_t* f, iid_t* from, iid_t* to)
+int learner_has_holes(struct learner* l, iid_t* from, iid_t* to)
 {
-	/*ǰ᰸žl->highest_iid_closedλ,мȫδͨiid*/
-	if(l->highest_iid_closed > l->current_iid){
-		*from = l->current_iid;
-		*to = l->highest_iid_closed;
+	return learner_next_hole(l, l->current_iid, from, to);
+}
 
-		return 1;
-	}
+/*startʼĵһûͨ᰸[from, to)Ѿͨ᰸hole*/
+int learner_next_hole(struct learner* l, iid_t start, iid_t* from, iid_t* to)
+{
+	iid_t limit = learner_hole_limit(l);
 
-	return 0;
+	if(start < l->current_iid)
+		start = l->current_iid;
+	if(start >= limit)
+		return 0;
+
+	*from = learner_scan_closed(l, start, limit, 0);
+	if(*from >= limit)
+		return 0;
+
+	*to = learner_scan_closed(l, *from, limit, 1);
+	return 1;
 }
 
-/*ͨiid᰸ʵ*/
-static struct instance* learner_get_instance(struct learner* l, iid_t iid)
+/*ҪholesϽ()highest_iid_closed֮ǰ(ָʱcatch_up_iid)᰸ӦѾͨ*/
+static iid_t learner_hole_limit(struct learner* l)
+{
+	iid_t highest = l->highest_iid_closed;
+
+	/*ָʱacceptorsϵ᰸Ҳûյ*/
+	if(l->catch_up_iid >= highest)
+		highest = l->catch_up_iid + 1;
+
+	/*֮ackᱻҪ*/
+	if(highest > l->current_iid + l->window)
+		highest = l->current_iid + l->window;
+
+	return highest;
+}
+
+/*[from, limit)ҵһͨ״̬closed᰸ûзlimitһμһ64λ*/
+static iid_t learner_scan_closed(struct learner* l, iid_t from, iid_t limit, int closed)
 {
-	khiter_t k = kh_get_instance(l->instances, iid);
-	if(k != kh_end(l->instances)){
-		return kh_value(l->instances, k);
+	iid_t pos;
+	uint64_t word;
+
+	while(from < limit){
+		pos = from % l->window;
+		word = l->closed[pos / 64];
+		if(!closed)
+			word = ~word;
+		word >>= pos % 64;
+
+		if(word != 0){
+			from += __builtin_ctzll(word);
+			return from < limit ? from : limit;
+		}
+
+		from += 64 - pos % 64;
 	}
 
-	return NULL;
+	return limit;
 }
 
-static struct instance* learner_get_current_instance(struct learner* l)
+/*Ӧø֪ѾӦõ᰸ţһ᰸ʼеʵȫ*/
+void learner_set_instance_id(struct learner* l, iid_t iid)
 {
-	return learner_get_instance(l, l->current_iid);
+	iid_t i;
+	for(i = 0; i < l->window; i++)
+		instance_clear(&l->instances[i], l->acceptors);
+	memset(l->closed, 0, l->window / 64 * sizeof(uint64_t));
+
+	l->late_start = 0;
+	l->current_iid = iid + 1;
+	l->highest_iid_closed = iid + 1;
+	l->catch_up_iid = 0;
 }
 
-static struct instance* learner_get_instance_or_create(struct learner* l, iid_t iid)
+/*acceptors֪᰸ţcurrent_iidiid֮᰸Ҫ*/
+void learner_catch_up(struct learner* l, iid_t iid)
 {
-	struct instance* inst = learner_get_instance(l, iid);
-	if (inst == NULL) { /*ûҵinstance,һµinstance*/
-		int rv;
-		khiter_t k = kh_put_instance(l->instances, iid, &rv);
-		assert(rv != -1);
+	if(iid > l->catch_up_iid)
+		l->catch_up_iid = iid;
+}
+
+/*proposerֵchosenϢӦʵѾ߳ڷNULL*/
+static struct instance* learner_get_instance_for(struct learner* l, iid_t iid)
+{
+	struct instance* inst;
+
+	if(l->late_start){
+		l->late_start = 0;
+		l->current_iid = iid;
+	}
+
+	if(iid < l->current_iid)
+		return NULL;
 
-		inst = instance_new(l->acceptors);
-		kh_value(l->instances, k) = inst;
+	inst = learner_get_instance_or_create(l, iid);
+	if(inst == NULL){
+		paxos_log_debug("Dropped value for iid %u. Out of window.", iid);
+		learner_catch_up(l, iid);
+		return NULL;
 	}
 
+	if(inst->iid == 0)
+		inst->iid = iid;
+
 	return inst;
 }
 
-static void learner_delete_instance(struct learner* l, struct instance* inst)
+/*ѾǴʵiidѾأΪͨiid,highest iidֵ*/
+static void learner_update_closed(struct learner* l, struct instance* inst)
+{
+	iid_t pos;
+
+	if(!instance_has_quorum(inst))
+		return;
+
+	pos = inst->iid % l->window;
+	/*ر֮ackߵֻڵһλʱ*/
+	if(!(l->closed[pos / 64] & ((uint64_t)1 << (pos % 64))))
+		l->closed_count++;
+	l->closed[pos / 64] |= (uint64_t)1 << (pos % 64);
+
+	if(inst->iid > l->highest_iid_closed)
+		l->highest_iid_closed = inst->iid;
+}
+
+/*ͨiid᰸ʵλеiidͬ˵ʵ*/
+static struct instance* learner_get_instance(struct learner* l, iid_t iid)
 {
-	khiter_t k;
-	k = kh_get_instance(l->instances, inst->iid);
-	kh_del_instance(l->instances, k);
+	struct instance* inst = &l->instances[iid % l->window];
+	if(inst->iid == iid)
+		return inst;
 
-	instance_free(inst, l->acceptors);
+	return NULL;
 }
 
-static struct instance* instance_new(int acceptors)
+static struct instance* learner_get_current_instance(struct learner* l)
+{
+	return learner_get_instance(l, l->current_iid);
+}
+
+static struct instance* learner_get_instance_or_create(struct learner* l, iid_t iid)
 {
-	int i;
 	struct instance* inst;
-	inst = (struct instance*)malloc(sizeof(struct instance));
-	memset(inst, 0, sizeof(struct instance));
 
-	/*acceptorһµacks飬Ϊһacceptorֻͨһ᰸һһӦ*/
-	inst->acks = (accept_ack**)malloc(sizeof(accept_ack*) * acceptors);
-	for (i = 0; i < acceptors; ++i)
-		inst->acks[i] = NULL;
+	/*֮ʵδʵòλܽ*/
+	if(iid >= l->current_iid + l->window)
+		return NULL;
+
+	inst = &l->instances[iid % l->window];
+	if(inst->iid != iid && inst->iid != 0){ /*λѾڵʵ(late start)պ*/
+		assert(inst->iid < l->current_iid);
+		learner_delete_instance(l, inst);
+	}
 
 	return inst;
 }
 
-static void instance_free(struct instance* inst, int acceptors)
+static void learner_delete_instance(struct learner* l, struct instance* inst)
 {
-	int i;
-	for (i = 0; i < acceptors; i++){
-		if (inst->acks[i] != NULL)
-			free(inst->acks[i]);
-	}
+	iid_t pos = inst->iid % l->window;
+	l->closed[pos / 64] &= ~((uint64_t)1 << (pos % 64));
+
+	instance_clear(inst, l->acceptors);
+}
 
-	free(inst->acks);
-	free(inst);
+/*ͷʵеֵλΪ*/
+static void instance_clear(struct instance* inst, int acceptors)
+{
+	int i;
+	for (i = 0; i < inst->nvalues; i++)
+		accept_ack_unref(inst->values[i].ack);
+	if(inst->proposed != NULL)
+		accept_ack_unref(inst->proposed);
+
+	memset(inst->acks, 0, sizeof(struct acceptor_ack) * acceptors);
+
+	inst->iid = 0;
+	inst->last_update_ballot = 0;
+	inst->closed = 0;
+	inst->nballots = 0;
+	inst->nvalues = 0;
+	inst->final_value = NULL;
+	inst->proposed = NULL;
+	inst->chosen_ballot = 0;
 }
 
 static void instance_update(struct instance* inst, accept_ack* ack, int acceptors)
 {
+	int count;
+	accept_ack* value;
+	struct acceptor_ack* prev_ack;
+
 	if(inst->iid == 0){ /*δֵinstanceһackͽиֵ*/
 		paxos_log_debug("Received first message for iid: %u", ack->iid);
 		inst->iid = ack->iid;
@@ -195,73 +427,196 @@ static void instance_update(struct instance* inst, accept_ack* ack, int acceptor
 	}
 
 	/*ѾͨԲܻ¼ظ*/
-	if(instance_has_quorum(inst, acceptors)){
+	if(inst->closed){
 		paxos_log_debug("Dropped accept_ack iid %u. Already closed.", ack->iid);
 		return;
 	}
 
 	/*жackǷ*/
-	accept_ack* prev_ack = inst->acks[ack->acceptor_id];
-	if(prev_ack != NULL && prev_ack->ballot >= ack->ballot){
+	prev_ack = &inst->acks[ack->acceptor_id];
+	if(prev_ack->ballot != 0 && prev_ack->ballot >= ack->ballot){
 		paxos_log_debug("Dropped accept_ack for iid %u. Previous ballot is newer or equal.", ack->iid);
 		return;
 	}
+
+	/*acceptor˸µballotɵballotһƱɵֵһ*/
+	if(prev_ack->ballot != 0){
+		instance_count_ballot(inst, prev_ack->ballot, -1);
+		instance_release_value(inst, prev_ack->value_ballot);
+	}
 	
 	instance_add_accept(inst, ack);
+	value = instance_retain_value(inst, ack);
+
+	/*acceptorϼ¼ѾͨͬһballotﵽʶΪͨ״̬*/
+	count = instance_count_ballot(inst, ack->ballot, 1);
+	if(ack->is_final || count >= paxos_quorum(acceptors)){
+		paxos_log_debug("Reached quorum, iid: %u is closed!", inst->iid);
+		inst->closed = 1;
+		inst->final_value = value;
+	}
+}
+
+/*chosenϢֵ˲ܹرգֵproposerҲԲʱacceptorطack*/
+static void instance_check_chosen(struct instance* inst)
+{
+	int i;
+
+	if(inst->chosen_ballot == 0)
+		return;
+
+	if(inst->proposed != NULL && inst->proposed->ballot == inst->chosen_ballot){
+		inst->final_value = inst->proposed;
+	}
+	else{
+		for(i = 0; i < inst->nvalues; i++){
+			if(inst->values[i].value_ballot == inst->chosen_ballot)
+				inst->final_value = inst->values[i].ack;
+		}
+	}
+
+	if(inst->final_value != NULL){
+		paxos_log_debug("Chosen value received, iid: %u is closed!", inst->iid);
+		inst->closed = 1;
+	}
 }
 
-static int instance_has_quorum(struct instance* inst, int acceptors)
+static int instance_has_quorum(struct instance* inst)
 {
-	accept_ack* curr_ack;
-	int i, a_valid_index = -1, count = 0;
+	return inst->closed;
+}
 
-	/*Ѿɴܣҽackݼ¼final_value*/
-	if(inst->final_value != NULL)
-		return 1;
+/*޸ballotļ޸ĺļһʵϲͬballotֻͨһ*/
+static int instance_count_ballot(struct instance* inst, ballot_t ballot, int delta)
+{
+	int i;
+	struct ballot_count* bc;
 
-	for(i = 0; i < acceptors; i++){
-		curr_ack = inst->acks[i];
-		if(curr_ack == NULL)
+	for(i = 0; i < inst->nballots; i++){
+		bc = &inst->ballots[i];
+		if(bc->ballot != ballot)
 			continue;
 
-		if (curr_ack->ballot == inst->last_update_ballot) { /*ͬľID*/
-			count ++;
-			a_valid_index = i;
+		bc->count += delta;
+		if(bc->count > 0)
+			return bc->count;
 
-			/*acceptorϼ¼ѾֱͨӱʶΪͨ״̬*/
-			if (curr_ack->is_final){
-				count += acceptors;
-				break;
-			}
-		}
+		/*Ϊ0һ*/
+		*bc = inst->ballots[--inst->nballots];
+		return 0;
 	}
 
-	/*жǷǴͨǱʶֵͨ*/
-	if(count >= paxos_quorum(acceptors)){
-		paxos_log_debug("Reached quorum, iid: %u is closed!", inst->iid);
-		inst->final_value = inst->acks[a_valid_index];
-		return 1;
-	}
+	if(delta <= 0)
+		return 0;
 
-	return 0;
+	bc = &inst->ballots[inst->nballots++];
+	bc->ballot = ballot;
+	bc->count = delta;
+	return delta;
 }
 
+/*ֻ¼acceptorballotԪݣֵinstance_retain_value*/
 static void instance_add_accept(struct instance* inst, accept_ack* ack)
 {
-	if (inst->acks[ack->acceptor_id] != NULL){ /*Ѿack*/
-		free(inst->acks[ack->acceptor_id]); /*ͷŵɵ*/
+	inst->acks[ack->acceptor_id].ballot = ack->ballot;
+	inst->acks[ack->acceptor_id].value_ballot = ack->value_ballot;
+	inst->last_update_ballot = ack->ballot;
+}
+
+/*ͬһvalue_ballotӦͬһֵֻƵһֵack֮ackֻӼ*/
+static accept_ack* instance_retain_value(struct instance* inst, accept_ack* ack)
+{
+	int i;
+	struct instance_value* v;
+
+	for(i = 0; i < inst->nvalues; i++){
+		v = &inst->values[i];
+		if(v->value_ballot == ack->value_ballot){
+			v->refs++;
+			return v->ack;
+		}
 	}
 
-	/*滻µ*/
-	inst->acks[ack->acceptor_id] = accept_ack_dup(ack);
-	inst->last_update_ballot = ack->ballot;
+	v = &inst->values[inst->nvalues++];
+	v->value_ballot = ack->value_ballot;
+	v->refs = 1;
+	v->ack = accept_ack_copy(ack);
+
+	return v->ack;
+}
+
+static void instance_release_value(struct instance* inst, ballot_t value_ballot)
+{
+	int i;
+	struct instance_value* v;
+
+	for(i = 0; i < inst->nvalues; i++){
+		v = &inst->values[i];
+		if(v->value_ballot != value_ballot)
+			continue;
+
+		if(--v->refs == 0){
+			accept_ack_unref(v->ack);
+			*v = inst->values[--inst->nvalues];
+		}
+		return;
+	}
+}
+
+/*ֵʵժߣ߸ͷ*/
+static accept_ack* instance_take_value(struct instance* inst, accept_ack* value)
+{
+	int i;
+	if(inst->proposed == value){
+		inst->proposed = NULL;
+		return value;
+	}
+
+	for(i = 0; i < inst->nvalues; i++){
+		if(inst->values[i].ack == value){
+			inst->values[i] = inst->values[--inst->nvalues];
+			break;
+		}
+	}
+
+	return value;
+}
+
+/*һsizeֽ(accept ackϢ)ĻʼΪ1*/
+accept_ack* accept_ack_alloc(size_t size)
+{
+	struct accept_ack_buf* buf = (struct accept_ack_buf*)malloc(offsetof(struct accept_ack_buf, ack) + size);
+	assert(buf != NULL);
+	buf->refs = 1;
+
+	return &buf->ack;
 }
 
-/*һaccept ack󲢶ackи*/
-static accept_ack* accept_ack_dup(accept_ack* ack)
+/*һacküĻ*/
+accept_ack* accept_ack_copy(accept_ack* ack)
 {
-	accept_ack* copy = (accept_ack *)malloc(ACCEPT_ACK_SIZE(ack));
+	accept_ack* copy = accept_ack_alloc(ACCEPT_ACK_SIZE(ack));
 	memcpy(copy, ack, ACCEPT_ACK_SIZE(ack));
 
 	return copy;
 }
+
+void accept_ack_ref(accept_ack* ack)
+{
+	struct accept_ack_buf* buf = (struct accept_ack_buf*)((char*)ack - offsetof(struct accept_ack_buf, ack));
+	__atomic_add_fetch(&buf->refs, 1, __ATOMIC_RELAXED);
+}
+
+void accept_ack_unref(accept_ack* ack)
+{
+	struct accept_ack_buf* buf = (struct accept_ack_buf*)((char*)ack - offsetof(struct accept_ack_buf, ack));
+	/*̺߳߳̿ͬʱ*/
+	if(__atomic_sub_fetch(&buf->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		free(buf);
+}
+
+/*ͨӦõֵָҵڵack*/
+accept_ack* accept_ack_of_value(char* value)
+{
+	return (accept_ack*)(value - offsetof(accept_ack, value));
+}
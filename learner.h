@@ -9,7 +9,20 @@ struct learner;
 struct learner* learner_new(int acceptors);
 void			learner_free(struct learner* l);
 void			learner_receive_accept(struct learner* l, accept_ack* ack);
+void			learner_receive_value(struct learner* l, accept_ack* ack);
+void			learner_receive_chosen(struct learner* l, iid_t iid, ballot_t ballot);
 accept_ack*		learner_deliver_next(struct learner* l);
-int				learner_has_holes(struct learner* l, iid_t* f, iid_t* from, iid_t* to);
+iid_t			learner_closed_count(struct learner* l);
+int				learner_has_holes(struct learner* l, iid_t* from, iid_t* to);
+int				learner_next_hole(struct learner* l, iid_t start, iid_t* from, iid_t* to);
+void			learner_set_instance_id(struct learner* l, iid_t iid);
+void			learner_catch_up(struct learner* l, iid_t iid);
+
+/*üaccept acklearnerֵͷӦõֵ*/
+accept_ack*		accept_ack_alloc(size_t size);
+accept_ack*		accept_ack_copy(accept_ack* ack);
+void			accept_ack_ref(accept_ack* ack);
+void			accept_ack_unref(accept_ack* ack);
+accept_ack*		accept_ack_of_value(char* value);
 
 #endif
@@ -23,14 +23,17 @@ int main(int argc, char const *argv[])
 	struct evlearner* lea;
 	struct event_base* base;
 
-	if (argc != 2) {
-		printf("Usage: %s config\n", argv[0]);
+	if (argc != 2 && argc != 3) {
+		printf("Usage: %s config [relay id]\n", argv[0]);
 		exit(1);
 	}
 
 	base = event_base_new();
 
-	lea = evlearner_init(argv[1], deliver, NULL, base);
+	if (argc == 3)
+		lea = evlearner_init_relay(argv[1], atoi(argv[2]), deliver, NULL, base);
+	else
+		lea = evlearner_init(argv[1], deliver, NULL, base);
 	if (lea == NULL) {
 		printf("Could not start the learner!\n");
 		exit(1);
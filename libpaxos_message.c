@@ -0,0 +1,122 @@
+#include "libpaxos_message.h"
+
+int paxos_sub_header_encode(void* buf, int type, uint32_t size)
+{
+	int n = 1;
+	unsigned char* p = buf;
+
+	p[0] = type;
+	while(size >= 0x80){
+		p[n++] = (size & 0x7f) | 0x80;
+		size >>= 7;
+	}
+	p[n++] = size;
+
+	return n;
+}
+
+int paxos_sub_header_decode(const void* buf, size_t len, paxos_msg* msg)
+{
+	size_t i;
+	uint32_t size = 0;
+	const unsigned char* p = buf;
+
+	for(i = 1; i < len && i < PAXOS_SUB_HEADER_MAX; i++){
+		size |= (uint32_t)(p[i] & 0x7f) << (7 * (i - 1));
+		if((p[i] & 0x80) == 0){
+			msg->version = PAXOS_WIRE_VERSION;
+			msg->type = p[0];
+			msg->data_size = size;
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+
+#define SWAP32(f)	((f) = le32toh(f))
+#define SWAP16(f)	((f) = le16toh(f))
+
+void paxos_msg_swap(int type, void* body)
+{
+	switch(type){
+	case prepare_reqs:{
+		prepare_req* m = body;
+		SWAP32(m->iid);
+		SWAP32(m->ballot);
+		break;
+	}
+	case prepare_acks:{
+		prepare_ack* m = body;
+		SWAP32(m->accept_id);
+		SWAP32(m->iid);
+		SWAP32(m->ballot);
+		SWAP32(m->value_ballot);
+		SWAP32(m->value_size);
+		break;
+	}
+	case accept_reqs:{
+		accept_req* m = body;
+		SWAP32(m->iid);
+		SWAP32(m->ballot);
+		SWAP32(m->value_size);
+		break;
+	}
+	case accept_acks:{
+		accept_ack* m = body;
+		SWAP32(m->acceptor_id);
+		SWAP32(m->iid);
+		SWAP32(m->ballot);
+		SWAP32(m->value_ballot);
+		SWAP16(m->is_final);
+		SWAP32(m->value_size);
+		break;
+	}
+	case repeat_reqs:{
+		repeat_req* m = body;
+		SWAP32(m->from);
+		SWAP32(m->to);
+		break;
+	}
+	case max_iid_acks:{
+		max_iid_ack* m = body;
+		SWAP32(m->acceptor_id);
+		SWAP32(m->iid);
+		SWAP32(m->ballot);
+		SWAP32(m->chosen_iid);
+		SWAP32(m->accepted_iid);
+		break;
+	}
+	case chosen_msgs:{
+		chosen_msg* m = body;
+		SWAP32(m->iid);
+		SWAP32(m->ballot);
+		break;
+	}
+	case chosen_upto_msgs:{
+		chosen_upto_msg* m = body;
+		SWAP32(m->iid);
+		break;
+	}
+	case credit_msgs:{
+		credit_msg* m = body;
+		SWAP32(m->acceptor_id);
+		SWAP32(m->instances);
+		SWAP32(m->bytes);
+		break;
+	}
+	case peer_hellos:{
+		peer_hello* m = body;
+		SWAP32(m->version);
+		SWAP32(m->role);
+		SWAP32(m->id);
+		break;
+	}
+	default: /*submitϢǲ͸ֽ*/
+		break;
+	}
+}
+
+#endif
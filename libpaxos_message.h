@@ -3,6 +3,12 @@
 
 #include "paxos.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <endian.h>
+
+/*ϸʽİ汾ʽвݵı仯ʱ1ֶζǶСṹû䣬
+  ͱֳ޹أͬĹ֮Իͨ()汾2batch_msgsŷ*/
+#define PAXOS_WIRE_VERSION	2
 
 typedef enum 
 {
@@ -14,57 +20,140 @@ typedef enum
 	submit			= 0x20,
 	leader_announce = 0x40, /*proposer leaderľЭ飬δʵ*/
 	alive_ping		= 0x41,
+	max_iid_reqs	= 0x42, /*proposerӹʱѯacceptorϵ᰸(phase 0)*/
+	max_iid_acks	= 0x43,
+	chosen_msgs		= 0x44, /*chosen-broadcastģʽproposer֪ͨlearners᰸Ѿͨ*/
+	/*0x45ڰ汾learner_subscribeѾpeer_helloslearnerɫȡʹ*/
+	batch_msgs		= 0x46, /*ŷ⣬ϢǶձϢշһȡӦҲϲһŷ*/
+	credit_msgs		= 0x47, /*acceptoraccept ackproposer;()*/
+	chosen_upto_msgs = 0x48, /*proposer֪ͨacceptorsΪֹ᰸Ѿͨ*/
+	peer_hellos		= 0x49, /*ӽ͵ĵһϢ˵Ľɫlearner˶proposerֵchosenϢ*/
 } paxos_msg_code;
 
 
+/*϶Զ˵Ľɫûзpeer_hello(ͻ)role_unknown*/
+typedef enum
+{
+	role_unknown	= 0,
+	role_proposer	= 1,
+	role_acceptor	= 2,
+	role_learner	= 3,
+} paxos_role;
+
 typedef struct paxos_msg_t
 {
-	size_t			data_size; /*пܻ32λϵͳ64λϵͳǲһ*/
-	paxos_msg_code	type;
+	uint8_t			version;	/*PAXOS_WIRE_VERSION*/
+	uint8_t			type;		/*paxos_msg_code*/
+	uint32_t		data_size;
 	char			data[0];
 } __attribute__((packed)) paxos_msg;
-#define PAXOS_MSG_SIZE(m)	(m->data_Size + sizeof(paxos_msg))
+#define PAXOS_MSG_SIZE(m)	(m->data_size + sizeof(paxos_msg))
+
+/*batch_msgsŷеϢͷ: 1ֽڵpaxos_msg_codevarint(LEB128)Ϣ峤ȣϢ塣
+  ϢûԼİ汾ŷͬ*/
+#define PAXOS_SUB_HEADER_MAX	6
+/*дֽbufPAXOS_SUB_HEADER_MAXֽ*/
+int		paxos_sub_header_encode(void* buf, int type, uint32_t size);
+/*bufǰlenֽڽϢͷmsgͷֽ߸ʽԷ0*/
+int		paxos_sub_header_decode(const void* buf, size_t len, paxos_msg* msg);
 
 typedef struct prepare_req_t 
 {
 	iid_t		iid;
 	ballot_t	ballot;
-} prepare_req;
-#define PREPARE_REQ_SIZE(m) (sizeof(prepare_req_t))
+} __attribute__((packed)) prepare_req;
+#define PREPARE_REQ_SIZE(m) (sizeof(prepare_req))
 
 typedef struct prepare_ack_t
 {
-	int			accept_id;		/*жacceptorݣڴж*/
+	int32_t		accept_id;		/*жacceptorݣڴж*/
 	iid_t		iid;
 	ballot_t	ballot;
 	ballot_t	value_ballot;
-	size_t		value_size;
+	uint32_t	value_size;
 	char		value[0];
-}prepare_ack;
+} __attribute__((packed)) prepare_ack;
 #define PREPARE_ACK_SIZE(m) (m->value_size + sizeof(prepare_ack))
 
 typedef struct accept_req_t
 {
 	iid_t		iid;
 	ballot_t	ballot;
-	size_t		value_size;
+	uint32_t	value_size;
 	char		value[0];
-}accept_req;
+} __attribute__((packed)) accept_req;
 #define ACCEPT_REQ_SIZE(m) (m->value_size + sizeof(accept_req))
 
 typedef struct accept_ack_t
 {
-	int			acceptor_id;
+	int32_t		acceptor_id;
 	iid_t		iid;
 	ballot_t	ballot;
 	ballot_t	value_ballot;
-	short int	is_final;
-	size_t		value_size;
+	int16_t		is_final;
+	uint32_t	value_size;
 	char		value[0];
-}accept_ack;
+} __attribute__((packed)) accept_ack;
 #define ACCEPT_ACK_SIZE(m) (m->value_size + sizeof(accept_ack))
 
+typedef struct repeat_req_t
+{
+	iid_t		from;
+	iid_t		to;				/*ط[from, to)֮᰸to*/
+} __attribute__((packed)) repeat_req;
+#define REPEAT_REQ_SIZE(m) (sizeof(repeat_req))
+
+typedef struct max_iid_ack_t
+{
+	int32_t		acceptor_id;
+	iid_t		iid;			/*acceptorϼ¼᰸*/
+	ballot_t	ballot;			/*᰸acceptorŵballot*/
+	iid_t		chosen_iid;		/*proposer֪ͨͨţӹʱָ֮*/
+	iid_t		accepted_iid;	/*acceptorֵܹ᰸ţlearnerָʱ*/
+} __attribute__((packed)) max_iid_ack;
+#define MAX_IID_ACK_SIZE(m) (sizeof(max_iid_ack))
+
+typedef struct chosen_msg_t
+{
+	iid_t		iid;
+	ballot_t	ballot;			/*ͨballotlearnerƥproposerֵ*/
+} __attribute__((packed)) chosen_msg;
+#define CHOSEN_MSG_SIZE(m) (sizeof(chosen_msg))
+
+typedef struct chosen_upto_msg_t
+{
+	iid_t		iid;			/*ż֮ǰ᰸Ѿͨ*/
+} __attribute__((packed)) chosen_upto_msg;
+#define CHOSEN_UPTO_MSG_SIZE(m) (sizeof(chosen_upto_msg))
+
+/*ڸ汾бֲ䣬շversionжܷͶԶ˻ͨͬʱϿ*/
+typedef struct peer_hello_t
+{
+	int32_t		version;		/*ͷʹõPAXOS_WIRE_VERSION*/
+	int32_t		role;			/*paxos_role*/
+	int32_t		id;
+} __attribute__((packed)) peer_hello;
+#define PEER_HELLO_SIZE(m) (sizeof(peer_hello))
+
+/*proposeracceptorûյaccept ack᰸instancesֵbytesֽ*/
+typedef struct credit_msg_t
+{
+	int32_t		acceptor_id;
+	uint32_t	instances;
+	uint32_t	bytes;
+} __attribute__((packed)) credit_msg;
+#define CREDIT_MSG_SIZE(m) (sizeof(credit_msg))
+
+/*acceptor洢ļ¼accept ackͬһ֣洢ʽҲϸʽ仯*/
 typedef accept_ack	acceptor_record;
 #define ACCEPT_RECORD_BUFF_SIZE(value_size) (value_size + sizeof(accept_ack))
 
+/*Ϣ嶨ֽСֽ֮ԭתͬһ
+  Ϣֵ(value)ǲ͸ֽڲתСʲô*/
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define paxos_msg_swap(type, body) ((void)0)
+#else
+void paxos_msg_swap(int type, void* body);
+#endif
+
 #endif
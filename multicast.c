@@ -0,0 +1,274 @@
+#include "multicast.h"
+#include "tcp_sendbuf.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define MCAST_RECV_MAX		(64 * 1024)		/*ʱUDPݱ󳤶ԤͷͷMTU޹*/
+#define MCAST_HEADER_SIZE	28				/*IPv4ͷUDPͷ*/
+#define MCAST_READ_MAX		256				/*һζ¼ȡݱ*/
+#define MCAST_RCVBUF		(4 * 1024 * 1024)
+
+struct mcast
+{
+	int					fd;
+	struct sockaddr_in	group;			/*͵Ŀĵַ*/
+	struct event*		read_ev;
+	struct event*		flush_ev;		/*¼ѭǰݴϢ*/
+	struct evbuffer*	pending;		/*ݴϢʱһһbatch_msgsŷ*/
+	int					count;			/*pendingϢĸ*/
+	struct evbuffer*	out;			/*õݱ*/
+	size_t				datagram_max;	/*һݱ󳤶ȣmulticast-mtuȥIPUDPͷ*/
+	struct evbuffer*	in;
+	mcast_read_cb		cb;
+	void*				arg;
+	unsigned long		dropped;		/*ʽԶݱ*/
+};
+
+static void mcast_on_read(evutil_socket_t fd, short event, void* arg);
+static void mcast_on_flush(evutil_socket_t fd, short event, void* arg);
+
+static int mcast_parse_interface(struct in_addr* in)
+{
+	in->s_addr = htonl(INADDR_ANY);
+	if(paxos_config.multicast_interface != NULL && inet_pton(AF_INET, paxos_config.multicast_interface, in) != 1){
+		paxos_log_error("Invalid multicast interface %s", paxos_config.multicast_interface);
+		return -1;
+	}
+	return 0;
+}
+
+static int mcast_join(struct mcast* m, struct in_addr* ifaddr)
+{
+	int one = 1;
+	int rcvbuf = MCAST_RCVBUF;
+	struct ip_mreq mreq;
+
+	/*ͬһ̨ϵĶ̶Խͬһ*/
+	setsockopt(m->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	setsockopt(m->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	/*󶨵鲥ַշ˿ڵݱ*/
+	if(bind(m->fd, (struct sockaddr *)&m->group, sizeof(m->group)) != 0){
+		paxos_log_error("Failed to bind multicast %s:%d: %s", paxos_config.multicast_group, ntohs(m->group.sin_port), strerror(errno));
+		return -1;
+	}
+
+	mreq.imr_multiaddr = m->group.sin_addr;
+	mreq.imr_interface = *ifaddr;
+	if(setsockopt(m->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0){
+		paxos_log_error("Failed to join multicast group %s: %s", paxos_config.multicast_group, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+struct mcast* mcast_new(struct event_base* b, int channel, mcast_read_cb cb, void* arg)
+{
+	unsigned char loop = 1;
+	unsigned char ttl;
+	struct in_addr ifaddr;
+	struct mcast* m;
+
+	if(paxos_config.multicast_group == NULL)
+		return NULL;
+
+	if(paxos_config.multicast_mtu <= MCAST_HEADER_SIZE + (int)sizeof(paxos_msg) || paxos_config.multicast_mtu > MCAST_RECV_MAX){
+		paxos_log_error("Invalid multicast mtu %d", paxos_config.multicast_mtu);
+		return NULL;
+	}
+
+	m = (struct mcast *)calloc(1, sizeof(struct mcast));
+	m->datagram_max = paxos_config.multicast_mtu - MCAST_HEADER_SIZE;
+	memset(&m->group, 0, sizeof(m->group));
+	m->group.sin_family = AF_INET;
+	m->group.sin_port = htons(paxos_config.multicast_port + channel);
+	if(inet_pton(AF_INET, paxos_config.multicast_group, &m->group.sin_addr) != 1 || !IN_MULTICAST(ntohl(m->group.sin_addr.s_addr))){
+		paxos_log_error("Invalid multicast group %s", paxos_config.multicast_group);
+		free(m);
+		return NULL;
+	}
+
+	m->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(m->fd < 0 || mcast_parse_interface(&ifaddr) != 0)
+		goto fail;
+
+	/*(ͬһ̨ϵlearner)Ҳյ*/
+	ttl = paxos_config.multicast_ttl;
+	setsockopt(m->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+	setsockopt(m->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+	if(setsockopt(m->fd, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)) != 0){
+		paxos_log_error("Failed to set multicast interface: %s", strerror(errno));
+		goto fail;
+	}
+
+	if(cb != NULL && mcast_join(m, &ifaddr) != 0)
+		goto fail;
+
+	evutil_make_socket_nonblocking(m->fd);
+	m->cb = cb;
+	m->arg = arg;
+	m->pending = evbuffer_new();
+	m->out = evbuffer_new();
+	m->in = evbuffer_new();
+	m->flush_ev = event_new(b, -1, 0, mcast_on_flush, m);
+	if(cb != NULL){
+		m->read_ev = event_new(b, m->fd, EV_READ | EV_PERSIST, mcast_on_read, m);
+		event_add(m->read_ev, NULL);
+	}
+
+	paxos_log_info("Multicast %s %s:%d", cb != NULL ? "receiving on" : "sending to", paxos_config.multicast_group, 
+		paxos_config.multicast_port + channel);
+	return m;
+
+fail:
+	if(m->fd >= 0)
+		close(m->fd);
+	free(m);
+	return NULL;
+}
+
+void mcast_free(struct mcast* m)
+{
+	if(m == NULL)
+		return;
+
+	if(m->read_ev != NULL)
+		event_free(m->read_ev);
+	event_free(m->flush_ev);
+	evbuffer_free(m->pending);
+	evbuffer_free(m->out);
+	evbuffer_free(m->in);
+	close(m->fd);
+	free(m);
+}
+
+/*ͣʱݱsocketں˶ָ󿿲һ*/
+void mcast_suspend_read(struct mcast* m)
+{
+	if(m != NULL && m->read_ev != NULL)
+		event_del(m->read_ev);
+}
+
+void mcast_resume_read(struct mcast* m)
+{
+	if(m != NULL && m->read_ev != NULL)
+		event_add(m->read_ev, NULL);
+}
+
+static void mcast_flush(struct mcast* m)
+{
+	size_t len;
+
+	if(m->count == 0)
+		return;
+
+	sendbuf_seal(m->pending, m->count, m->out);
+	m->count = 0;
+	len = evbuffer_get_length(m->out);
+
+	/*ʧ(ENOBUFS)ͬڶ*/
+	if(sendto(m->fd, evbuffer_pullup(m->out, len), len, 0, (struct sockaddr *)&m->group, sizeof(m->group)) < 0)
+		paxos_log_debug("Multicast of %u bytes failed: %s", (unsigned)len, strerror(errno));
+
+	evbuffer_drain(m->out, len);
+}
+
+static void mcast_on_flush(evutil_socket_t fd, short event, void* arg)
+{
+	mcast_flush((struct mcast *)arg);
+}
+
+static int mcast_add(struct mcast* m, paxos_msg_code c, const void* a, size_t alen)
+{
+	/*Ϣͷ㣬ŷͷλ*/
+	size_t size = PAXOS_SUB_HEADER_MAX + alen;
+
+	if(sizeof(paxos_msg) + size > m->datagram_max)
+		return -1;
+
+	if(sizeof(paxos_msg) + evbuffer_get_length(m->pending) + size > m->datagram_max)
+		mcast_flush(m);
+
+	if(m->count == 0)
+		event_active(m->flush_ev, EV_WRITE, 0);
+	sendbuf_encode_sub(m->pending, c, a, alen, NULL, 0);
+	m->count++;
+
+	return 0;
+}
+
+int mcast_add_accept_req(struct mcast* m, accept_req* ar)
+{
+	return mcast_add(m, accept_reqs, ar, ACCEPT_REQ_SIZE(ar));
+}
+
+int mcast_add_accept_ack(struct mcast* m, acceptor_record* rec)
+{
+	return mcast_add(m, accept_acks, rec, ACCEPT_ACK_SIZE(rec));
+}
+
+int mcast_add_accept_ack_header(struct mcast* m, acceptor_record* rec)
+{
+	accept_ack aa = *rec;
+
+	aa.value_size = 0;
+	return mcast_add(m, accept_acks, &aa, sizeof(accept_ack));
+}
+
+int mcast_add_credit(struct mcast* m, credit_msg* cm)
+{
+	return mcast_add(m, credit_msgs, cm, CREDIT_MSG_SIZE(cm));
+}
+
+/*һݱһ֡(һϢһŷ)ƴһȡŷɽշ*/
+static int mcast_valid_datagram(const char* buf, ssize_t n)
+{
+	paxos_msg h;
+
+	if(n < (ssize_t)sizeof(paxos_msg))
+		return 0;
+
+	memcpy(&h, buf, sizeof(paxos_msg));
+	return h.version == PAXOS_WIRE_VERSION && sizeof(paxos_msg) + le32toh(h.data_size) == (size_t)n;
+}
+
+static void mcast_on_read(evutil_socket_t fd, short event, void* arg)
+{
+	int i;
+	ssize_t n;
+	struct mcast* m = (struct mcast *)arg;
+	struct evbuffer_iovec v;
+
+	for(i = 0; i < MCAST_READ_MAX; i++){
+		if(evbuffer_reserve_space(m->in, MCAST_RECV_MAX, &v, 1) < 1)
+			break;
+
+		n = recv(fd, v.iov_base, MCAST_RECV_MAX, 0);
+		if(n < 0){
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				paxos_log_error("Multicast receive failed: %s", strerror(errno));
+			break;
+		}
+
+		if(!mcast_valid_datagram(v.iov_base, n)){
+			m->dropped++;
+			paxos_log_debug("Dropped invalid multicast datagram of %d bytes", (int)n);
+			continue;
+		}
+
+		v.iov_len = n;
+		evbuffer_commit_space(m->in, &v, 1);
+	}
+
+	if(evbuffer_get_length(m->in) > 0){
+		m->cb(m->in, m->arg);
+		evbuffer_drain(m->in, evbuffer_get_length(m->in));
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef __PAXOS_MULTICAST_H
+#define __PAXOS_MULTICAST_H
+
+#include "paxos.h"
+#include "libpaxos_message.h"
+#include <event2/event.h>
+#include <event2/buffer.h>
+
+/*Ring PaxosʽUDP鲥ַ: proposeraccept reqs鲥飬acceptorsaccept acks鲥飬
+  leaderĳͼȺС޹ء鲥ɿʧϢproposerʱطlearnerָ
+  multicast-group򿪣ÿͨʹmulticast-portͨŵĶ˿ڡ
+  ֵaccept acksֻlearnersproposersֻ벻ֵackͶȵͨýֵ*/
+enum mcast_channel
+{
+	mcast_accept_reqs	= 0,	/*proposeraccept reqsacceptorsգchosen-broadcastģʽlearnersҲ*/
+	mcast_accept_acks	= 1,	/*ֵaccept ackslearners*/
+	mcast_proposer_acks	= 2,	/*ֵaccept acksnacksͶȣproposers*/
+};
+
+struct mcast;
+
+/*inɸ֡ӵ뻺һrecvbuf_dispatchصغʣµĶ*/
+typedef void (*mcast_read_cb)(struct evbuffer* in, void* arg);
+
+/*cbΪNULLʱֻڷͣ鲥աû鲥ʱNULLʹõ
+  鲥ʼʧҲNULLӦóʼʧܣ˻ص(acceptorղ鲥accept reqs)*/
+struct mcast*	mcast_new(struct event_base* b, int channel, mcast_read_cb cb, void* arg);
+void			mcast_free(struct mcast* m);
+void			mcast_suspend_read(struct mcast* m);
+void			mcast_resume_read(struct mcast* m);
+
+/*Ϣڱ¼ѭǰϲɾٵݱݱmulticast-mtuһݱŲµϢ-1߸õ*/
+int				mcast_add_accept_req(struct mcast* m, accept_req* ar);
+int				mcast_add_accept_ack(struct mcast* m, acceptor_record* rec);
+int				mcast_add_accept_ack_header(struct mcast* m, acceptor_record* rec);
+int				mcast_add_credit(struct mcast* m, credit_msg* cm);
+
+#endif
@@ -9,8 +9,24 @@ struct paxos_config paxos_config =
 	PAXOS_LOG_INFO,    /* verbosity */
 	2048,              /* learner_instances */
 	1,                 /* learner_catchup */
+	0,                 /* learner_delivery_thread */
+	1024,              /* learner_delivery_queue */
+	-1,                /* learner_relay */
+	0,                 /* chosen_broadcast */
+	64*1024*1024,      /* peer_queue_high */
+	16*1024*1024,      /* peer_queue_low */
+	0,                 /* peer_slow_disconnect */
+	0,                 /* io_uring */
+	NULL,              /* multicast_group */
+	9100,              /* multicast_port */
+	NULL,              /* multicast_interface */
+	1,                 /* multicast_ttl */
+	1500,              /* multicast_mtu */
 	1,                 /* proposer_timeout */
 	128,               /* proposer_preexec_window */
+	0,                 /* acceptor_net_threads */
+	1024,              /* acceptor_credit_instances */
+	16*1024*1024,      /* acceptor_credit_bytes */
 	0,                 /* bdb_sync */
 	32*1024*1024,      /* bdb_cachesize */
 	"/tmp/acceptor",   /* bdb_env_path */
@@ -22,6 +38,7 @@ void paxos_log(int level, const char* format, va_list ap)
 {
 	int off;
 	char msg[1024];
+	struct tm tm;
 	struct timeval tv;
 
 	if(level > paxos_config.verbosity)
@@ -29,7 +46,8 @@ void paxos_log(int level, const char* format, va_list ap)
 
 	/*get datetime*/
 	gettimeofday(&tv,NULL);
-	off = strftime(msg, sizeof(msg), "%d %b %H:%M:%S. ", localtime(&tv.tv_sec));
+	/*߳Ҳд־ÿlocaltime_r*/
+	off = strftime(msg, sizeof(msg), "%d %b %H:%M:%S. ", localtime_r(&tv.tv_sec, &tm));
 	/*write log*/
 	vsnprintf(msg + off, sizeof(msg) - off, format, ap);
 	fprintf(stdout,"%s\n", msg);
@@ -23,12 +23,35 @@ struct paxos_config
 	/*Learner conf*/
 	int		learn_instances;
 	int		learner_catch_up;
+	int		learner_delivery_thread;	/*ڵ߳÷ص*/
+	int		learner_delivery_queue;	/*̺߳ͷ֮߳Ķг*/
+	int		learner_relay;			/*ӵĸlearnerм̣-1ʾֱacceptors*/
+
+	/*proposer㲥: acceptorֻproposerزֵackproposerchosenϢlearners
+	  ֵ鲥(learnersaccept reqs)мַ߶ûʱ*/
+	int		chosen_broadcast;
+
+	/*Peer confproposerlearneracceptor*/
+	int		peer_queue_high;		/*ôֽΪԶ˹*/
+	int		peer_queue_low;			/*ĶԶôֽºָ*/
+	int		peer_slow_disconnect;	/*ĶԶ: yesϿnoϢطָ*/
+	int		io_uring;				/*tcpunixӵշʹio_uring֧ʱ˻libevent*/
+
+	/*Multicast confaccept reqsaccept acksͨUDP鲥ַ*/
+	char*	multicast_group;		/*鲥ַûʱʹ鲥*/
+	int		multicast_port;			/*accept reqsĶ˿ڣlearnersaccept acks͸proposersacksʹú˿*/
+	char*	multicast_interface;	/*շ鲥ıؽӿڵַ127.0.0.1*/
+	int		multicast_ttl;
+	int		multicast_mtu;			/*鲥·MTUݱIPƬ(һƬͶݱ)*/
 
 	/*Proposer conf*/
 	int		proposer_timeout;
 	int		proposer_preexec_window;
 
 	/*Acceptor conf*/
+	int		acceptor_net_threads;		/*̸߳0ʾacceptor¼ѭֱշ*/
+	int		acceptor_credit_instances;	/*proposer;᰸ѹʱӦ*/
+	int		acceptor_credit_bytes;		/*proposer;ֵֽ*/
 
 	/*BDB storge conf*/
 	int		bdb_sync;
@@ -1,17 +1,31 @@
 #include "peers.h"
+#include "tcp_sendbuf.h"
+#include "tcp_recvbuf.h"
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
+#include <event2/buffer.h>
 #include <event2/bufferevent.h>
 
+/*״̬¼ʽάܴbuffereventǷдƶ(úµbuffereventҲǿд)*/
+enum peer_state
+{
+	peer_connecting,	/*ӣдӽ󷢳*/
+	peer_connected,		/*յBEV_EVENT_CONNECTED*/
+	peer_waiting,		/*ӶϿȴʱ*/
+};
+
 struct peer
 {
 	struct bufferevent* bev;
 	struct event*		reconnect_ev;
-	struct sockaddr_in	addr;
+	struct transport_addr	addr;
 	bufferevent_data_cb	cb;
 	void*				arg;
+	struct peers*		owner;
+	struct peer_stats	stats;
+	enum peer_state		state;
 };
 
 struct peers
@@ -19,21 +33,27 @@ struct peers
 	int					count;
 	struct peer**		peers;/*peer*/
 	struct event_base*	base;
+	int					role;	/*˵Ľɫ(paxos_role)*/
+	int					id;
 };
 
 /*ʱ*/
 static struct timeval reconnect_timeout = {2, 0};
 
-static struct peer* make_peer(struct event_base* base, struct sockaddr_in* addr, bufferevent_data_cb cb, void* arg);
+static struct peer* make_peer(struct peers* owner, struct transport_addr* addr, bufferevent_data_cb cb, void* arg);
 static void free_peer(struct peer* p);
 static void connect_peer(struct peer* p);
+static void reset_peer(struct peer* p);
+static void on_socket_event(struct bufferevent* bev, short ev, void* arg);
 
-struct peers* peers_new(struct event_base* base)
+struct peers* peers_new(struct event_base* base, int role, int id)
 {
 	struct peers* p = (struct peers *)malloc(sizeof(struct peers));
 	p->count = 0;
 	p->peers = NULL;
 	p->base = base;
+	p->role = role;
+	p->id = id;
 
 	return p;
 }
@@ -51,10 +71,10 @@ void peers_free(struct peers* p)
 		free(p);
 	}
 }
-void peers_connect(struct peers* p, struct sockaddr_in* addr, bufferevent_data_cb cb, void* arg)
+void peers_connect(struct peers* p, struct transport_addr* addr, bufferevent_data_cb cb, void* arg)
 {
 	p->peers = realloc(p->peers, sizeof(struct peer*) * (p->count+1));
-	p->peers[p->count] = make_peer(p->base, addr, cb, arg);
+	p->peers[p->count] = make_peer(p, addr, cb, arg);
 	p->count++;
 }
 /*еacceptor*/
@@ -62,19 +82,123 @@ void peers_connect_to_acceptors(struct peers* p, struct evpaxos_config* conf, bu
 {
 	int i;
 	for(i = 0; i < evpaxos_acceptor_count(conf); i++){
-		struct sockaddr_in addr = evpaxos_acceptor_address(c, i);
+		struct transport_addr addr = evpaxos_acceptor_address(conf, i);
 		peers_connect(p, &addr, cb, arg);
 	}
 }
 
-int peer_count(struct peers* p)
+int peers_count(struct peers* p)
 {
 	return p->count;
 }
 
 struct bufferevent* peers_get_buffer(struct peers* p, int i)
 {
-	return p->peers[i]->bev;
+	struct peer* peer = p->peers[i];
+	size_t queued = evbuffer_get_length(bufferevent_get_output(peer->bev));
+
+	if(queued > peer->stats.max_queued)
+		peer->stats.max_queued = queued;
+
+	if(!peer->stats.slow && queued >= (size_t)paxos_config.peer_queue_high){
+		paxos_log_error("Peer %s is too slow, %u bytes queued", 
+			peer->addr.desc, (unsigned)queued);
+
+		if(paxos_config.peer_slow_disconnect){
+			/*ϿŶӵݶطָ*/
+			peer->stats.disconnects++;
+			reset_peer(peer);
+		}
+		else
+			peer->stats.slow = 1;
+
+		peer->stats.dropped++;
+		return NULL;
+	}
+
+	/*ȴڼϢҪܷԶѳʱطֱӶ*/
+	if(peer->stats.slow || peer->state == peer_waiting){
+		peer->stats.dropped++;
+		return NULL;
+	}
+
+	return peer->bev;
+}
+
+void peers_get_stats(struct peers* p, int i, struct peer_stats* stats)
+{
+	struct peer* peer = p->peers[i];
+
+	*stats = peer->stats;
+	stats->queued = evbuffer_get_length(bufferevent_get_output(peer->bev));
+}
+
+/*ͣpeerȡϢsocketTCPطѹԶ*/
+void peers_suspend_read(struct peers* p)
+{
+	int i;
+	for(i = 0; i < p->count; i++)
+		bufferevent_disable(p->peers[i]->bev, EV_READ);
+}
+
+void peers_resume_read(struct peers* p)
+{
+	int i;
+	for(i = 0; i < p->count; i++)
+		bufferevent_enable(p->peers[i]->bev, EV_READ);
+}
+
+/*buffereventĻصpeerתϲĻص*/
+static void on_read(struct bufferevent* bev, void* arg)
+{
+	paxos_msg msg;
+	struct peer* p = (struct peer*)arg;
+
+	p->cb(bev, p->arg);
+
+	/*ϲصܽϢͣ£Զ˵ϰ汾ͬϿʱصпѾӣp->bev*/
+	if(recvbuf_next_msg(bufferevent_get_input(p->bev), &msg) < 0){
+		paxos_log_error("Wire version mismatch with %s", p->addr.desc);
+		reset_peer(p);
+	}
+}
+
+/*ˮλ£ĶԶ˻ָ*/
+static void on_write(struct bufferevent* bev, void* arg)
+{
+	struct peer* p = (struct peer*)arg;
+
+	if(p->stats.slow){
+		p->stats.slow = 0;
+		paxos_log_info("Peer %s recovered, %lu messages dropped so far", 
+			p->addr.desc, p->stats.dropped);
+	}
+}
+
+/*ͷӲʱûȥݼͳ*/
+static void reset_peer(struct peer* p)
+{
+	struct event_base* base = bufferevent_get_base(p->bev);
+	size_t lost = evbuffer_get_length(bufferevent_get_output(p->bev));
+
+	if(lost > 0){
+		p->stats.lost_bytes += lost;
+		paxos_log_error("Lost %u queued bytes to %s", (unsigned)lost, p->addr.desc);
+	}
+
+	/*һֹ㲥(cork)мϿ*/
+	sendbuf_forget(p->bev);
+	bufferevent_free(p->bev);
+	/*¿һµSOCKET֮ǰpeers_get_bufferNULL*/
+	p->bev = transport_new(base, &p->addr, BEV_OPT_CLOSE_ON_FREE);
+	p->stats.slow = 0;
+	p->state = peer_waiting;
+
+	/*¼ص*/
+	bufferevent_setcb(p->bev, on_read, on_write, on_socket_event, p);
+	bufferevent_setwatermark(p->bev, EV_WRITE, paxos_config.peer_queue_low, 0);
+	/*ʱ*/
+	event_add(p->reconnect_ev, &reconnect_timeout);
 }
 
 static void on_socket_event(struct bufferevent* bev, short ev, void* arg)
@@ -82,21 +206,12 @@ static void on_socket_event(struct bufferevent* bev, short ev, void* arg)
 	struct peer* p = (struct peer*)arg;
 
 	if (ev & BEV_EVENT_CONNECTED){
-		paxos_log_info("Connected to %s:%d", inet_ntoa(p->addr.sin_addr), ntohs(p->addr.sin_port));
+		p->state = peer_connected;
+		paxos_log_info("Connected to %s", p->addr.desc);
 	} else if (ev & BEV_EVENT_ERROR || ev & BEV_EVENT_EOF) { /*ʧܻsocketд*/
-		struct event_base* base;
 		int err = EVUTIL_SOCKET_ERROR();
-		paxos_log_error("%s (%s:%d)", evutil_socket_error_to_string(err), inet_ntoa(p->addr.sin_addr), ntohs(p->addr.sin_port));
-
-		base = bufferevent_get_base(p->bev);
-		bufferevent_free(p->bev);
-		/*¿һµSOCKET*/
-		p->bev = bufferevent_socket_new(base, -1, BEV_OPT_CLOSE_ON_FREE);
-
-		/*¼ص*/
-		bufferevent_setcb(p->bev, on_read, NULL, on_socket_event, p);
-		/*ʱ*/
-		event_add(p->reconnect_ev, &reconnect_timeout);
+		paxos_log_error("%s (%s)", evutil_socket_error_to_string(err), p->addr.desc);
+		reset_peer(p);
 	} else {
 		paxos_log_error("Event %d not handled", ev);
 	}
@@ -109,21 +224,33 @@ static void on_connection_timeout(int fd, short ev, void* arg)
 
 static void connect_peer(struct peer* p)
 {
+	p->state = peer_connecting;
 	bufferevent_enable(p->bev, EV_READ|EV_WRITE);
-	bufferevent_socket_connect(p->bev, struct sockaddr*)&p->addr, sizeof(p->addr));
-	paxos_log_info("Connect to %s:%d", inet_ntoa(p->addr.sin_addr), ntohs(p->addr.sin_port));
+	if(transport_connect(p->bev, &p->addr) != 0){
+		paxos_log_error("Failed to connect to %s: %s", p->addr.desc, strerror(errno));
+		reset_peer(p);
+		return;
+	}
+	/*ÿ()ӶɫӽǰдݻӺ󷢳*/
+	sendbuf_add_peer_hello(p->bev, p->owner->role, p->owner->id);
+	paxos_log_info("Connect to %s", p->addr.desc);
 }
 
 /*һpeer*/
-static struct peer* make_peer(struct event_base* base, struct sockaddr_in* addr, bufferevent_data_cb cb, void* arg)
+static struct peer* make_peer(struct peers* owner, struct transport_addr* addr, bufferevent_data_cb cb, void* arg)
 {
 	struct peer* p = (struct peer *)malloc(sizeof(struct peer));
 	p->addr = *addr;
-	p->reconnect_ev = evtimer_new(base, on_connection_timeout, p); /*ӳʱص*/
+	p->reconnect_ev = evtimer_new(owner->base, on_connection_timeout, p); /*ӳʱص*/
 	p->cb = cb;
 	p->arg = arg;
+	p->owner = owner;
+	memset(&p->stats, 0, sizeof(struct peer_stats));
+	p->bev = transport_new(owner->base, &p->addr, BEV_OPT_CLOSE_ON_FREE);
 
-	bufferevent_setcb(p->bev, on_read, NULL, on_socket_event, p); /*¼ص*/
+	bufferevent_setcb(p->bev, on_read, on_write, on_socket_event, p); /*¼ص*/
+	/*дصֻˮλʱ*/
+	bufferevent_setwatermark(p->bev, EV_WRITE, paxos_config.peer_queue_low, 0);
 	connect_peer(p);
 
 	return p;
@@ -6,11 +6,27 @@
 
 struct peers;
 
-struct peers*		peers_new(struct event_base* base);
+/*һpeerеͳ*/
+struct peer_stats
+{
+	size_t			queued;			/*ǰеֽ*/
+	size_t			max_queued;		/*۲쵽ֵ*/
+	unsigned long	dropped;		/*Զ˹ʱϢ*/
+	unsigned long	disconnects;	/*ΪϿĴ*/
+	size_t			lost_bytes;		/*ӶϿʱûзֽ*/
+	int				slow;			/*ǰǷڹ״̬*/
+};
+
+/*roleidÿӽʱͨpeer_hello֪Զ*/
+struct peers*		peers_new(struct event_base* base, int role, int id);
 void				peers_free(struct peers* p);
-void				peers_connect(struct peers* p, struct sockadd_in* addr, bufferevent_data_cb cb, void* arg);
+void				peers_connect(struct peers* p, struct transport_addr* addr, bufferevent_data_cb cb, void* arg);
 void				peers_connect_to_acceptors(struct peers* p, struct evpaxos_config* conf, bufferevent_data_cb cb, void* arg);
 int					peers_count(struct peers* p);
+/*Զ˹(peer-queue-highֱpeer-queue-low)ʱNULLη*/
 struct bufferevent* peers_get_buffer(struct peers* p, int i);
+void				peers_get_stats(struct peers* p, int i, struct peer_stats* stats);
+void				peers_suspend_read(struct peers* p);
+void				peers_resume_read(struct peers* p);
 
 #endif
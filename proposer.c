@@ -20,6 +20,15 @@ struct instance
 
 KHASH_MAP_INIT_INT(instance, struct instance*);
 
+/*һacceptorĶȺproposerûյaccept ack᰸*/
+struct credit
+{
+	int					instances;
+	int					bytes;
+	int					inflight;
+	int					inflight_bytes;
+};
+
 struct proposer
 {
 	int					id;
@@ -28,6 +37,17 @@ struct proposer
 	iid_t				next_prepare_iid;
 	khash_t(instance)*  prepare_instances;
 	khash_t(instance)*  accept_instances;
+
+	/*phase 0: ӹǰacceptorsѯ᰸*/
+	int					ready;				/*phase 0Ƿɣǰprepare*/
+	iid_t				max_iid;			/*acceptorӦе᰸*/
+	iid_t				chosen_iid;			/*Ӧһproposer֪ͨͨ*/
+	ballot_t			max_ballot;			/*Ӧŵballot*/
+	ballot_t			start_ballot;		/*᰸ĳʼballot*/
+	struct quorum		max_iid_quorum;
+
+	/*: quorumĶȾܷٸڶ׶*/
+	struct credit*		credits;
 };
 
 struct timeout_iterator
@@ -38,6 +58,7 @@ struct timeout_iterator
 };
 
 static ballot_t			proposer_next_ballot(struct proposer* p, ballot_t b);
+static ballot_t			proposer_ballot_above(struct proposer* p, ballot_t b);
 static void				proposer_preempt(struct proposer* p, struct instance* inst, prepare_req* out);
 static void				proposer_move_instance(struct proposer* p, khash_t(instance)* f, 	khash_t(instance)* t, struct instance* inst);
 
@@ -47,10 +68,15 @@ static void				instance_free(struct instance* inst);
 static int				instance_has_timedout(struct instance* inst, struct timeval* now);
 
 static accept_req*		instance_to_accept_req(struct instance* inst);
+static int				credit_allows(struct proposer* p, size_t size);
+static void				credit_acquire(struct proposer* p, struct instance* inst);
+static void				credit_release(struct proposer* p, struct instance* inst, int acceptor_id);
+static void				credit_release_all(struct proposer* p, struct instance* inst);
 static paxos_msg*		wrap_value(const char* value, size_t size);
 
 struct proposer* proposer_new(int id, int acceptors)
 {
+	int i;
 	struct proposer* p = malloc(sizeof(struct proposer));
 	p->id = id;
 	p->acceptors = acceptors;
@@ -58,6 +84,22 @@ struct proposer* proposer_new(int id, int acceptors)
 	p->values = carray_new(128);
 	p->prepare_instances = kh_init(instance);
 	p->accept_instances = kh_init(instance);
+
+	p->ready = 0;
+	p->max_iid = 0;
+	p->chosen_iid = 0;
+	p->max_ballot = 0;
+	p->start_ballot = proposer_next_ballot(p, 0);
+	quorum_init(&p->max_iid_quorum, acceptors);
+
+	/*յacceptorĵһ֮ǰõĶȷ*/
+	p->credits = (struct credit *)calloc(acceptors, sizeof(struct credit));
+	for(i = 0; i < acceptors; i++){
+		p->credits[i].instances = paxos_config.acceptor_credit_instances;
+		p->credits[i].bytes = paxos_config.acceptor_credit_bytes;
+	}
+
+	return p;
 }
 
 void proposer_free(struct proposer* p)
@@ -69,6 +111,7 @@ void proposer_free(struct proposer* p)
 		kh_foreach_value(p->accept_instances, inst, instance_free(inst));
 		kh_destroy(instance, p->prepare_instances);
 		kh_destroy(instance, p->accept_instances);
+		quorum_destroy(&p->max_iid_quorum);
 
 		for(i = 0; i < carray_count(p->values); i++){
 			free(carray_at(p->values, i));
@@ -76,6 +119,7 @@ void proposer_free(struct proposer* p)
 
 		carray_free(p->values);
 
+		free(p->credits);
 		free(p);
 	}
 }
@@ -93,12 +137,68 @@ int proposer_prepared_count(struct proposer* p)
 	return kh_size(p->prepare_instances);
 }
 
+int proposer_is_ready(struct proposer* p)
+{
+	return p->ready;
+}
+
+/*phase 0ӦacceptorӦ֪ȫͨı֮ʼprepare
+  max_iidΪֹ᰸Ƿ񱻽ܹһһ׶*/
+int proposer_receive_max_iid_ack(struct proposer* p, max_iid_ack* ack)
+{
+	if(p->ready){
+		paxos_log_debug("Max iid ack dropped, proposer already recovered");
+		return 0;
+	}
+
+	if(!quorum_add(&p->max_iid_quorum, ack->acceptor_id)){
+		paxos_log_debug("Duplicate max iid ack dropped from: %d", ack->acceptor_id);
+		return 0;
+	}
+
+	if(ack->iid > p->max_iid)
+		p->max_iid = ack->iid;
+	if(ack->ballot > p->max_ballot)
+		p->max_ballot = ack->ballot;
+	/*ͨproposerȷϹģκһacceptorĶ*/
+	if(ack->chosen_iid > p->chosen_iid)
+		p->chosen_iid = ack->chosen_iid;
+
+	if(!quorum_reached(&p->max_iid_quorum))
+		return 0;
+
+	/*һproposerܹûдﵽ᰸preexec_windowƣֻ֮ͨǰĿ*/
+	p->next_prepare_iid = p->chosen_iid < p->max_iid ? p->chosen_iid : p->max_iid;
+	p->start_ballot = proposer_ballot_above(p, p->max_ballot);
+	p->ready = 1;
+
+	paxos_log_info("Recovered max iid %u chosen up to %u, preparing from iid %u with ballot %u", 
+		p->max_iid, p->chosen_iid, p->next_prepare_iid + 1, p->start_ballot);
+
+	return 1;
+}
+
+/*ż֮ǰ᰸ѾͨڽеС᰸ż1*/
+iid_t proposer_chosen_iid(struct proposer* p)
+{
+	struct instance* inst;
+	iid_t iid = p->next_prepare_iid;
+
+	if(!p->ready)
+		return 0;
+
+	kh_foreach_value(p->prepare_instances, inst, { if(inst->iid <= iid) iid = inst->iid - 1; });
+	kh_foreach_value(p->accept_instances, inst, { if(inst->iid <= iid) iid = inst->iid - 1; });
+
+	return iid;
+}
+
 /*淢᰸Ϣ״̬һprepare req*/
 void proposer_prepare(struct proposer* p, prepare_req* out)
 {
 	int rv;
 	iid_t iid = ++(p->next_prepare_iid);
-	ballot_t bal = proposer_next_ballot(p, NULL);
+	ballot_t bal = p->start_ballot;
 	struct instance* inst = instance_new(iid, bal, p->acceptors);
 	khiter_t k = kh_put_instance(p->prepare_instances, iid, &rv);
 	assert(rv > 0);
@@ -157,6 +257,7 @@ int proposer_receive_prepare_ack(struct proposer* p, prepare_ack* ack, prepare_r
 accept_req* proposer_accept(struct proposer* p)
 {
 	 khiter_t k;
+	 paxos_msg* value;
 	 struct instance* inst = NULL;
 	 khash_t(instance)* h = p->prepare_instances;
 
@@ -174,6 +275,13 @@ accept_req* proposer_accept(struct proposer* p)
 
 	 paxos_log_debug("Trying to accept iid %u", inst->iid);
 
+	 /*acceptorû㹻ĶȣǵackµĶ*/
+	 value = inst->value != NULL ? inst->value : (paxos_msg *)carray_front(p->values);
+	 if(value != NULL && !credit_allows(p, value->data_size)){
+		 paxos_log_debug("No credit to accept iid %u", inst->iid);
+		 return NULL;
+	 }
+
 	 if(inst->value == NULL){
 		 inst->value = carray_pop_front(p->values);  /*óһֵΪݣڶ׶*/
 		 if(inst->value == NULL){ /*ֵɽ飬ֱȡ*/
@@ -184,12 +292,16 @@ accept_req* proposer_accept(struct proposer* p)
 	 
 	 /*instprepare instancesƵaccept instances*/
 	 proposer_move_instance(p, p->prepare_instances, p->accept_instances, inst);
+	 credit_acquire(p, inst);
 	 /*һaccept_reqϢṹ*/
 	 return instance_to_accept_req(inst);
 }
 
-int proposer_receive_accept_ack(struct proposer* p, accept_ack* ack, prepare_req* out)
+/*1ʾ᰸ռҪ·out᰸ackϴﵽʱ*chosenΪ1*/
+int proposer_receive_accept_ack(struct proposer* p, accept_ack* ack, prepare_req* out, int* chosen)
 {
+	*chosen = 0;
+
 	khiter_t k = kh_get_instance(p->accept_instances, ack->iid);
 	if(k == kh_end(p->accept_instances)){
 		paxos_log_debug("Accept ack dropped, iid: %u not pending", ack->iid);
@@ -205,17 +317,22 @@ int proposer_receive_accept_ack(struct proposer* p, accept_ack* ack, prepare_req
 				ack->acceptor_id, inst->iid);
 			return 0;
 		}
+		credit_release(p, inst, ack->acceptor_id);
 
 		if(quorum_reached(&inst->quorum)){ /*ͨ߿ɾݣlearnersaccpetorѧϰ*/
 			paxos_log_debug("Quorum reached for instance %u", inst->iid);
+			/*֮󵽴ackټ룬ûӦacceptor;Ҳһͷ*/
+			credit_release_all(p, inst);
 			kh_del_instance(p->accept_instances, k);
 			instance_free(inst);
+			*chosen = 1;
 		}
 
 		return 0;
 	}
 	else{
 		paxos_log_debug("Instance %u preempted: ballot %d ack ballot %d", inst->iid, inst->ballot, ack->ballot);
+		credit_release_all(p, inst);
 		if(inst->value_ballot == 0)
 			carray_push_back(p->values, inst->value); /*ֵ»صδĶУȴһ*/
 		else /*ǷǷߴ飬ֱӶ*/
@@ -292,6 +409,89 @@ void timeout_iterator_free(struct timeout_iterator* iter)
 	free(iter);
 }
 
+/*acceptoraccept ack¶*/
+void proposer_receive_credit(struct proposer* p, credit_msg* cm)
+{
+	if(cm->acceptor_id < 0 || cm->acceptor_id >= p->acceptors){
+		paxos_log_debug("Credit dropped from unknown acceptor %d", cm->acceptor_id);
+		return;
+	}
+
+	p->credits[cm->acceptor_id].instances = cm->instances;
+	p->credits[cm->acceptor_id].bytes = cm->bytes;
+}
+
+/*һacceptorϻܷ᰸û;acceptorǿٷһΪ0ʱῨס*/
+static int credit_margin(struct credit* c)
+{
+	int n = c->instances - c->inflight;
+	if(c->inflight == 0 && n < 1)
+		n = 1;
+	return n;
+}
+
+/*quorumacceptorϻܷ᰸Ѿprepare᰸ҲҪռ*/
+int proposer_credit(struct proposer* p)
+{
+	int i, j, n, rank;
+	int best = 0;
+
+	for(i = 0; i < p->acceptors; i++){
+		n = credit_margin(&p->credits[i]);
+		/*quorumacceptorСn*/
+		for(j = 0, rank = 0; j < p->acceptors; j++){
+			if(credit_margin(&p->credits[j]) >= n)
+				rank++;
+		}
+		if(rank >= paxos_quorum(p->acceptors) && n > best)
+			best = n;
+	}
+
+	return best;
+}
+
+/*acceptor;ĸֵֽ󲻳ȡû;acceptorֵڶʱҲܷ*/
+static int credit_allows(struct proposer* p, size_t size)
+{
+	int i, n = 0;
+	struct credit* c;
+
+	for(i = 0; i < p->acceptors; i++){
+		c = &p->credits[i];
+		if(c->inflight == 0 || (c->inflight < c->instances && c->inflight_bytes + size <= (size_t)c->bytes))
+			n++;
+	}
+
+	return n >= paxos_quorum(p->acceptors);
+}
+
+/*ڶ׶Σÿacceptorռһ*/
+static void credit_acquire(struct proposer* p, struct instance* inst)
+{
+	int i;
+	for(i = 0; i < p->acceptors; i++){
+		p->credits[i].inflight++;
+		p->credits[i].inflight_bytes += inst->value->data_size;
+	}
+}
+
+/*acceptor_idackѾinst->quorum*/
+static void credit_release(struct proposer* p, struct instance* inst, int acceptor_id)
+{
+	p->credits[acceptor_id].inflight--;
+	p->credits[acceptor_id].inflight_bytes -= inst->value->data_size;
+}
+
+/*ͷŻûӦacceptorռ*/
+static void credit_release_all(struct proposer* p, struct instance* inst)
+{
+	int i;
+	for(i = 0; i < p->acceptors; i++){
+		if(!inst->quorum.acceptor_ids[i])
+			credit_release(p, inst, i);
+	}
+}
+
 static ballot_t	proposer_next_ballot(struct proposer* p, ballot_t b)
 {
 	/*һ*/
@@ -301,6 +501,16 @@ static ballot_t	proposer_next_ballot(struct proposer* p, ballot_t b)
 		return MAX_N_OF_PROPOSERS + p->id;
 }
 
+/*bСıproposerballot*/
+static ballot_t proposer_ballot_above(struct proposer* p, ballot_t b)
+{
+	ballot_t bal = (b / MAX_N_OF_PROPOSERS) * MAX_N_OF_PROPOSERS + p->id;
+	while(bal <= b || bal < MAX_N_OF_PROPOSERS)
+		bal += MAX_N_OF_PROPOSERS;
+
+	return bal;
+}
+
 static void proposer_preempt(struct proposer* p, struct instance* inst, prepare_req* out)
 {
 	inst->ballot = proposer_next_ballot(p, inst->ballot);
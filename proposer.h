@@ -13,13 +13,22 @@ void						proposer_free(struct proposer* p);
 void						proposer_propose(struct proposer* p, const char* value, size_t size);
 int							proposer_prepared_count(struct proposer* p);
 
+/*phase 0*/
+int							proposer_is_ready(struct proposer* p);
+int							proposer_receive_max_iid_ack(struct proposer* p, max_iid_ack* ack);
+
 /*phase 1*/
 void						proposer_prepare(struct proposer* p, prepare_req* out);
 int							proposer_receive_prepare_ack(struct proposer* p, prepare_ack* ack, prepare_req* out);
 
 /*phase 2*/
 accept_req*					proposer_accept(struct proposer* p);
-int							proposer_receive_accept_ack(struct proposer* p, accept_ack* ack, prepare_req* out);
+int							proposer_receive_accept_ack(struct proposer* p, accept_ack* ack, prepare_req* out, int* chosen);
+iid_t						proposer_chosen_iid(struct proposer* p);
+
+/*flow control*/
+void						proposer_receive_credit(struct proposer* p, credit_msg* cm);
+int							proposer_credit(struct proposer* p);
 
 /*timeouts*/
 struct timeout_iterator*	proposer_timeout_iterator(struct proposer* p);
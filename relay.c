@@ -0,0 +1,180 @@
+#include "relay.h"
+#include "learner.h"
+#include "tcp_receiver.h"
+#include "tcp_sendbuf.h"
+#include <stdlib.h>
+#include <string.h>
+#include <event2/buffer.h>
+#include <event2/event.h>
+
+struct relay
+{
+	struct tcp_receiver*	receiver;	/*learner*/
+	int						size;		/*ʷ᰸*/
+	accept_ack**			history;	/*᰸iid % sizeţβ*/
+	iid_t					last_iid;	/*ת᰸*/
+	struct carray*			repeats;	/*ûطĲÿ¼صһ*/
+	struct event*			repeat_ev;
+};
+
+#define RELAY_REPEAT_MAX 10000
+/*һ¼صط᰸ʣµó¼ѭ*/
+#define RELAY_REPEAT_BATCH 256
+
+/*һûطĲӹرպbevΪNULL*/
+struct relay_repeat_job
+{
+	struct bufferevent*	bev;
+	iid_t				from;
+	iid_t				to;
+};
+
+/*learnerкӱʷط*/
+static void relay_handle_repeat_req(struct relay* r, struct bufferevent* bev, repeat_req* rr)
+{
+	struct relay_repeat_job* job;
+
+	if(bev == NULL || rr->from >= rr->to)
+		return;
+
+	job = (struct relay_repeat_job *)malloc(sizeof(struct relay_repeat_job));
+	job->bev = bev;
+	job->from = rr->from;
+	job->to = rr->to;
+	if(job->to - rr->from > RELAY_REPEAT_MAX)
+		job->to = rr->from + RELAY_REPEAT_MAX;
+
+	carray_push_back(r->repeats, job);
+	event_active(r->repeat_ev, EV_TIMEOUT, 0);
+}
+
+/*Ӷ׵طһûɵķŻضβlearner*/
+static void relay_handle_repeats(evutil_socket_t fd, short event, void* arg)
+{
+	iid_t end;
+	accept_ack* ack;
+	struct relay_repeat_job* job;
+	struct relay* r = (struct relay *)arg;
+
+	job = carray_pop_front(r->repeats);
+	if(job == NULL)
+		return;
+
+	if(job->bev != NULL){
+		end = job->from + RELAY_REPEAT_BATCH;
+		if(end > job->to)
+			end = job->to;
+
+		sendbuf_cork();
+		for(; job->from < end; job->from++){
+			ack = r->history[job->from % r->size];
+			if(ack != NULL && ack->iid == job->from)
+				sendbuf_add_final_accept_ack(job->bev, ack);
+			else if(job->from <= r->last_iid)
+				paxos_log_debug("Relay instance %u no longer retained", job->from);
+		}
+		sendbuf_uncork();
+	}
+
+	if(job->bev != NULL && job->from < job->to)
+		carray_push_back(r->repeats, job);
+	else
+		free(job);
+
+	if(!carray_empty(r->repeats))
+		event_active(r->repeat_ev, EV_TIMEOUT, 0);
+}
+
+/*ӹرգûɵĲ*/
+static void relay_handle_close(struct bufferevent* bev, void* arg)
+{
+	int i;
+	struct relay* r = (struct relay *)arg;
+
+	for(i = 0; i < carray_count(r->repeats); i++){
+		struct relay_repeat_job* job = carray_at(r->repeats, i);
+		if(job->bev == bev)
+			job->bev = NULL;
+	}
+}
+
+/*learnerָʱѯмѾ᰸*/
+static void relay_handle_max_iid_req(struct relay* r, struct bufferevent* bev)
+{
+	max_iid_ack ack;
+	ack.acceptor_id = 0;
+	ack.iid = r->last_iid;
+	ack.ballot = 0;
+	ack.chosen_iid = r->last_iid;
+	ack.accepted_iid = r->last_iid;
+	sendbuf_add_max_iid_ack(bev, &ack);
+}
+
+static void relay_handle_req(struct bufferevent* bev, paxos_msg* msg, void* body, void* arg)
+{
+	struct relay* r = arg;
+
+	switch(msg->type){
+	case repeat_reqs:
+		if(msg->data_size >= sizeof(repeat_req))
+			relay_handle_repeat_req(r, bev, (repeat_req*)body);
+		break;
+	case max_iid_reqs:
+		relay_handle_max_iid_req(r, bev);
+		break;
+	default:
+		paxos_log_error("Relay: unknow msg type %d not handled", msg->type);
+	}
+}
+
+struct relay* relay_new(struct event_base* b, struct transport_addr* addr, int history)
+{
+	struct relay* r = (struct relay *)malloc(sizeof(struct relay));
+
+	r->size = history;
+	r->history = (accept_ack**)calloc(history, sizeof(accept_ack*));
+	r->last_iid = 0;
+	r->repeats = carray_new(16);
+	r->repeat_ev = event_new(b, -1, 0, relay_handle_repeats, r);
+	r->receiver = tcp_receiver_new(b, addr, relay_handle_req, r);
+	tcp_receiver_set_close_cb(r->receiver, relay_handle_close);
+
+	return r;
+}
+
+void relay_free(struct relay* r)
+{
+	int i;
+	if(r != NULL){
+		tcp_receiver_free(r->receiver);
+		while(!carray_empty(r->repeats))
+			free(carray_pop_front(r->repeats));
+		carray_free(r->repeats);
+		event_free(r->repeat_ev);
+		for(i = 0; i < r->size; i++){
+			if(r->history[i] != NULL)
+				accept_ack_unref(r->history[i]);
+		}
+		free(r->history);
+		free(r);
+	}
+}
+
+/*˳תlearnerñڲ*/
+void relay_forward(struct relay* r, accept_ack* ack)
+{
+	int i;
+	accept_ack** slot;
+	struct carray* bevs = tcp_receiver_get_events(r->receiver);
+
+	for(i = 0; i < carray_count(bevs); i++)
+		sendbuf_add_final_accept_ack(carray_at(bevs, i), ack);
+
+	slot = &r->history[ack->iid % r->size];
+	if(*slot != NULL)
+		accept_ack_unref(*slot);
+	accept_ack_ref(ack);
+	*slot = ack;
+
+	r->last_iid = ack->iid;
+}
@@ -0,0 +1,17 @@
+#ifndef __PAXOS_RELAY_H
+#define __PAXOS_RELAY_H
+
+#include "paxos.h"
+#include "libpaxos_message.h"
+#include "transport.h"
+#include <event2/event.h>
+
+/*learnerм̣ѱlearner˳򷢱᰸תlearner
+  learnerӵм̶acceptorsacceptorķlearner*/
+struct relay;
+
+struct relay*	relay_new(struct event_base* b, struct transport_addr* addr, int history);
+void			relay_free(struct relay* r);
+void			relay_forward(struct relay* r, accept_ack* ack);
+
+#endif
@@ -0,0 +1,86 @@
+#include "spsc_ring.h"
+#include <stdlib.h>
+#include <assert.h>
+
+#define SPSC_CACHE_LINE 64
+
+struct spsc_ring
+{
+	/*ֻ޸*/
+	unsigned	tail;
+	char		pad1[SPSC_CACHE_LINE - sizeof(unsigned)];
+	/*ֻ޸*/
+	unsigned	head;
+	char		pad2[SPSC_CACHE_LINE - sizeof(unsigned)];
+
+	unsigned	mask;		/*size - 1, size2*/
+	void**		array;
+};
+
+struct spsc_ring* spsc_ring_new(int size)
+{
+	unsigned n = 1;
+	struct spsc_ring* r;
+	assert(size > 0);
+
+	/*ȡ2ݣ±&%*/
+	while(n < (unsigned)size)
+		n <<= 1;
+
+	r = (struct spsc_ring *)malloc(sizeof(struct spsc_ring));
+	assert(r);
+
+	r->head = 0;
+	r->tail = 0;
+	r->mask = n - 1;
+	r->array = (void**)malloc(sizeof(void*) * n);
+	assert(r->array);
+
+	return r;
+}
+
+void spsc_ring_free(struct spsc_ring* r)
+{
+	if(r != NULL){
+		free(r->array);
+		free(r);
+	}
+}
+
+int spsc_ring_size(struct spsc_ring* r)
+{
+	return r->mask + 1;
+}
+
+int spsc_ring_count(struct spsc_ring* r)
+{
+	return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+}
+
+/*ߵã-1*/
+int spsc_ring_push(struct spsc_ring* r, void* p)
+{
+	unsigned tail = r->tail;
+	if(tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) > r->mask)
+		return -1;
+
+	r->array[tail & r->mask] = p;
+	/*release֤߿tail֮ǰԪѾд*/
+	__atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/*ߵãпշNULL*/
+void* spsc_ring_pop(struct spsc_ring* r)
+{
+	void* p;
+	unsigned head = r->head;
+	if(head == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	p = r->array[head & r->mask];
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+	return p;
+}
@@ -0,0 +1,15 @@
+#ifndef __PAXOS_SPSC_RING_H
+#define __PAXOS_SPSC_RING_H
+
+/*ߵߵζУߺ߿ڲͬ߳*/
+struct spsc_ring;
+
+struct spsc_ring* spsc_ring_new(int size);
+void spsc_ring_free(struct spsc_ring* r);
+int spsc_ring_size(struct spsc_ring* r);
+int spsc_ring_count(struct spsc_ring* r);
+
+int spsc_ring_push(struct spsc_ring* r, void* p);
+void* spsc_ring_pop(struct spsc_ring* r);
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /*asprintf*/
 #include "storage.h"
 #include <db.h> /*Berkeley DB*/
 #include <stdio.h>
@@ -6,6 +7,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <assert.h>
+#include <arpa/inet.h>
 
 
 struct storage
@@ -16,6 +18,30 @@ struct storage
 	int		acceptor_id;
 };
 
+/*iidΪ0key᰸acceptorԼ״̬*/
+#define STORAGE_META_IID	0
+
+/*洢ʽİ汾¼ֱӰacceptor_record(ϵaccept ack)Ĳִֻ̣keyııʱ1
+  ɸʽĴ洢ܰ²ֶȡʱܾ*/
+#define STORAGE_FORMAT_VERSION	1
+
+struct storage_meta
+{
+	uint32_t	version;		/*STORAGE_FORMAT_VERSION*/
+	iid_t		chosen_iid;
+};
+
+static int storage_check_format(struct storage* s);
+
+/*keyǴ˵iidBTREEֽڱȽϵ˳iidĴС˳һkey᰸*/
+static void storage_key(DBT* key, uint32_t* buf, iid_t iid)
+{
+	memset(key, 0, sizeof(DBT));
+	*buf = htonl(iid);
+	key->data = buf;
+	key->size = sizeof(uint32_t);
+}
+
 
 static int bdb_init_tx_handle(struct storage* s, char* db_env_path)
 {
@@ -144,13 +170,20 @@ struct storage* storage_open(int acceptor_id)
 	}
 
 	free(db_env_path);
+
+	if(storage_check_format(s) != 0){
+		storage_close(s);
+		return NULL;
+	}
+
+	return s;
 }
 
 int storage_close(struct storage* s)
 {
 	int result = 0;
 	if(s == NULL)
-		return ;
+		return 0;
 
 	if (s->db->close(s->db, 0) != 0) {
 		paxos_log_error("DB_ENV close failed");
@@ -192,17 +225,15 @@ void storage_free_record(struct storage* s, acceptor_record* r)
 acceptor_record* storage_get_record(struct storage* s, iid_t iid)
 {
 	int flags, result;
+	uint32_t key;
 	DBT dbkey, dbdata;
 	DB* dbp = s->db;
 	DB_TXN* txn = s->txn;
 	acceptor_record* record_buffer = NULL;
 
-	memset(&dbkey, 0, sizeof(DBT));
+	storage_key(&dbkey, &key, iid);
 	memset(&dbdata, 0, sizeof(DBT));
 
-	dbkey.data = &iid;
-	dkbkey.size = sizeof(iid_t);
-
 	dbdata.flags = DB_DBT_MALLOC;
 
 	flags = 0;
@@ -222,9 +253,58 @@ acceptor_record* storage_get_record(struct storage* s, iid_t iid)
 	return record_buffer;
 }
 
+/*iid˳ȡ[from, to)֮ڵļ¼maxضĸһα궨λ˳ȡiid*/
+int storage_get_records(struct storage* s, iid_t from, iid_t to, acceptor_record** recs, int max)
+{
+	int ret, n = 0;
+	uint32_t k;
+	DBC* dbcp;
+	DBT dbkey, dbdata;
+	DB* dbp = s->db;
+
+	/*iidΪ0״̬¼*/
+	if(from == STORAGE_META_IID)
+		from = STORAGE_META_IID + 1;
+
+	if((ret = dbp->cursor(dbp, s->txn, &dbcp, 0)) != 0){
+		dbp->err(dbp, ret, "DB->cursor");
+		return 0;
+	}
+
+	storage_key(&dbkey, &k, from);
+	memset(&dbdata, 0, sizeof(DBT));
+	dbdata.flags = DB_DBT_MALLOC;
+
+	/*λһСfromkey*/
+	ret = dbcp->c_get(dbcp, &dbkey, &dbdata, DB_SET_RANGE);
+	while(ret == 0){
+		if(ntohl(*(uint32_t *)dbkey.data) >= to){
+			free(dbdata.data);
+			break;
+		}
+
+		recs[n++] = (acceptor_record *)dbdata.data;
+		if(n == max)
+			break;
+
+		memset(&dbdata, 0, sizeof(DBT));
+		dbdata.flags = DB_DBT_MALLOC;
+		ret = dbcp->c_get(dbcp, &dbkey, &dbdata, DB_NEXT);
+	}
+
+	if(ret != 0 && ret != DB_NOTFOUND)
+		dbp->err(dbp, ret, "DBcursor->get");
+
+	if ((ret = dbcp->c_close(dbcp)) != 0)
+		dbp->err(dbp, ret, "DBcursor->close");
+
+	return n;
+}
+
 acceptor_record* storage_save_accept(struct storage* s, accept_req* ar)
 {
-	int flags;
+	int result;
+	uint32_t key;
 	DBT dbkey, dbdata;
 	DB* dbp = s->db;
 	DB_TXN* txn = s->txn;
@@ -240,23 +320,25 @@ acceptor_record* storage_save_accept(struct storage* s, accept_req* ar)
 	record_buffer->value_size = ar->value_size;
 	memcpy(record_buffer->value, ar->value, ar->value_size);
 
-	memset(&dbkey, 0, sizeof(DBT));
-	memset(&dbdata, 0, sizeof(DBT));
-
 	/*Key is iid*/
-	dbkey.data = &ar->iid;
-	dbkey.size = sizeof(iid_t);
+	storage_key(&dbkey, &key, ar->iid);
+	memset(&dbdata, 0, sizeof(DBT));
 
 	/*data*/
 	dbdata.data = record_buffer;
 	dbdata.size = ACCEPT_ACK_SIZE(record_buffer);
 
-	return dbp->put(dbp, txn, &dbkey, &dbdata, 0);
+	result = dbp->put(dbp, txn, &dbkey, &dbdata, 0);
+	if(result != 0)
+		paxos_log_error("Error while saving accept for iid %u: %s", ar->iid, db_strerror(result));
+
+	return record_buffer;
 }
 
 acceptor_record* storage_save_prepare(struct storage* s, prepare_req * pr)
 {
-	int flags, result;
+	int result;
+	uint32_t key;
 	DBT dbkey, dbdata;
 	DB* dbp = s->db;
 	DB_TXN* txn = s->txn;
@@ -275,24 +357,23 @@ acceptor_record* storage_save_prepare(struct storage* s, prepare_req * pr)
 	/*ͶƱID*/
 	record_buffer->ballot = pr->ballot;
 
-	memset(&dbkey, 0, sizeof(DBT));
+	storage_key(&dbkey, &key, pr->iid);
 	memset(&dbdata, 0, sizeof(DBT));
 
-	dbkey.data = &pr->iid;
-	dbkey.size = sizeof(iid_t);
-
 	dbdata.data = record_buffer;
 	dbdata.size = ACCEPT_RECORD_BUFF_SIZE(record_buffer->value_size);
 	/*дݿ*/
 	result = dbp->put(dbp, txn, &dbkey, &dbdata, 0);
-	assert(result);
+	if(result != 0)
+		paxos_log_error("Error while saving prepare for iid %u: %s", pr->iid, db_strerror(result));
 
 	return record_buffer;
 }
 
 acceptor_record* storage_save_final_value(struct storage* s, char* value, size_t size, iid_t iid, ballot_t b)
 {
-	int flags, result;
+	int result;
+	uint32_t key;
 	DBT dbkey, dbdata;
 	DB* dbp = s->db;
 	DB_TXN* txn = s->txn;
@@ -305,16 +386,14 @@ acceptor_record* storage_save_final_value(struct storage* s, char* value, size_t
 	record_buffer->value_size = size;
 	memcpy(record_buffer->value, value, size);
 
-	memset(&dbkey, 0, sizeof(DBT));
+	storage_key(&dbkey, &key, iid);
 	memset(&dbdata, 0, sizeof(DBT));
 
-	dbkey.data = &iid;
-	dbkey.size = sizeof(iid_t);
-
 	dbdata.data = record_buffer;
 	dbdata.size = ACCEPT_ACK_SIZE(record_buffer);
 	result = dbp->put(dbp, txn, &dbkey, &dbdata, 0);
-	assert(result);
+	if(result != 0)
+		paxos_log_error("Error while saving final value for iid %u: %s", iid, db_strerror(result));
 
 	return record_buffer;
 }
@@ -330,21 +409,21 @@ iid_t storage_get_max_iid(struct storage * s)
 	/*һα*/
 	if ((ret = dbp->cursor(dbp, NULL, &dbcp, 0)) != 0) {
 		dbp->err(dbp, ret, "DB->cursor");
-		return (1);
+		return 0;
 	}
 
-	memset(&dbkey, 0, sizeof(DBT));
-	memset(&dbdata, 0, sizeof(DBT));
+	memset(&key, 0, sizeof(DBT));
+	memset(&data, 0, sizeof(DBT));
+	/*ֻҪkey¼*/
+	data.flags = DB_DBT_PARTIAL;
+	data.dlen = 0;
 
-	while((ret = dbcp->c_get(dbcp, &key, &data, DB_NEXT)) == 0){
-		max_iid = *(iid_t *)key.data;
-	}
-
-	/*c_getʧ*/
-	if(ret != DB_NOTFOUND){
-		dbp->error(dbp, ret, "DBcursor->get");
-		max_iid = 0;
-	}
+	/*keyiid˳Уһ᰸*/
+	ret = dbcp->c_get(dbcp, &key, &data, DB_LAST);
+	if(ret == 0)
+		max_iid = ntohl(*(uint32_t *)key.data);
+	else if(ret != DB_NOTFOUND) /*c_getʧ*/
+		dbp->err(dbp, ret, "DBcursor->get");
 
 	/*رα*/
 	if ((ret = dbcp->c_close(dbcp)) != 0){
@@ -354,3 +433,135 @@ iid_t storage_get_max_iid(struct storage * s)
 	return max_iid;
 }
 
+/*ֵܹ᰸šһkeyǰңֻҪĩβprepareûнܵļ¼*/
+iid_t storage_get_max_accepted_iid(struct storage* s)
+{
+	int ret;
+	iid_t iid, max_iid = 0;
+	acceptor_record rec;
+	DB *dbp = s->db;
+	DBC *dbcp;
+	DBT key, data;
+
+	if ((ret = dbp->cursor(dbp, NULL, &dbcp, 0)) != 0) {
+		dbp->err(dbp, ret, "DB->cursor");
+		return 0;
+	}
+
+	memset(&key, 0, sizeof(DBT));
+	memset(&data, 0, sizeof(DBT));
+	/*ֻ¼Ķ*/
+	data.data = &rec;
+	data.ulen = sizeof(acceptor_record);
+	data.dlen = sizeof(acceptor_record);
+	data.flags = DB_DBT_USERMEM | DB_DBT_PARTIAL;
+
+	ret = dbcp->c_get(dbcp, &key, &data, DB_LAST);
+	while(ret == 0){
+		iid = ntohl(*(uint32_t *)key.data);
+		if(iid == STORAGE_META_IID)
+			break;
+		if(rec.value_ballot != 0){
+			max_iid = iid;
+			break;
+		}
+		ret = dbcp->c_get(dbcp, &key, &data, DB_PREV);
+	}
+
+	if(ret != 0 && ret != DB_NOTFOUND)
+		dbp->err(dbp, ret, "DBcursor->get");
+
+	if ((ret = dbcp->c_close(dbcp)) != 0)
+		dbp->err(dbp, ret, "DBcursor->close");
+
+	return max_iid;
+}
+
+/*ȡacceptor״̬¼ûʱ(µĴ洢)0*/
+static int storage_get_meta(struct storage* s, struct storage_meta* meta)
+{
+	int result;
+	uint32_t key;
+	DBT dbkey, dbdata;
+	DB* dbp = s->db;
+
+	storage_key(&dbkey, &key, STORAGE_META_IID);
+	memset(&dbdata, 0, sizeof(DBT));
+	dbdata.data = meta;
+	dbdata.ulen = sizeof(struct storage_meta);
+	dbdata.flags = DB_DBT_USERMEM;
+
+	memset(meta, 0, sizeof(struct storage_meta));
+	result = dbp->get(dbp, s->txn, &dbkey, &dbdata, 0);
+	if(result != 0 && result != DB_NOTFOUND){
+		paxos_log_error("Error while reading storage meta: %s", db_strerror(result));
+		return -1;
+	}
+
+	/*ȲԵǾɸʽ״̬ûа汾*/
+	if(result == 0 && dbdata.size != sizeof(struct storage_meta))
+		memset(meta, 0, sizeof(struct storage_meta));
+
+	return 0;
+}
+
+static int storage_save_meta(struct storage* s, struct storage_meta* meta)
+{
+	int result;
+	uint32_t key;
+	DBT dbkey, dbdata;
+	DB* dbp = s->db;
+
+	storage_key(&dbkey, &key, STORAGE_META_IID);
+	memset(&dbdata, 0, sizeof(DBT));
+	dbdata.data = meta;
+	dbdata.size = sizeof(struct storage_meta);
+
+	result = dbp->put(dbp, s->txn, &dbkey, &dbdata, 0);
+	if(result != 0){
+		paxos_log_error("Error while saving storage meta: %s", db_strerror(result));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*յĴ洢д뵱ǰĸʽ汾м¼ûа汾߰汾ͬĴ洢ܾ򿪣ҪǨƻbdb-trash-filesؽ*/
+static int storage_check_format(struct storage* s)
+{
+	int result = 0;
+	iid_t max_iid = storage_get_max_iid(s);
+	struct storage_meta meta;
+
+	storage_tx_begin(s);
+	if(storage_get_meta(s, &meta) != 0)
+		result = -1;
+	else if(meta.version == 0 && max_iid == STORAGE_META_IID){
+		meta.version = STORAGE_FORMAT_VERSION;
+		result = storage_save_meta(s, &meta);
+	}
+	else if(meta.version != STORAGE_FORMAT_VERSION){
+		paxos_log_error("Storage format version %u is not supported, expected %u", meta.version, STORAGE_FORMAT_VERSION);
+		result = -1;
+	}
+	storage_tx_commit(s);
+
+	return result;
+}
+
+iid_t storage_get_chosen_iid(struct storage* s)
+{
+	struct storage_meta meta;
+	storage_get_meta(s, &meta);
+	return meta.chosen_iid;
+}
+
+void storage_save_chosen_iid(struct storage* s, iid_t iid)
+{
+	struct storage_meta meta;
+	if(storage_get_meta(s, &meta) != 0)
+		return;
+
+	meta.chosen_iid = iid;
+	storage_save_meta(s, &meta);
+}
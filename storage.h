@@ -14,11 +14,15 @@ void				storage_tx_commit(struct storage* s);
 
 void				storage_free_record(struct storage* s, acceptor_record* r);
 acceptor_record*	storage_get_record(struct storage* s, iid_t iid);
+int					storage_get_records(struct storage* s, iid_t from, iid_t to, acceptor_record** recs, int max);
 
 acceptor_record*	storage_save_accept(struct storage* s, accept_req * ar);
 acceptor_record*	storage_save_prepare(struct storage* s, prepare_req * pr);
 acceptor_record*	storage_save_final_value(struct storage* s, char * value, size_t size, iid_t iid, ballot_t ballot);
 iid_t				storage_get_max_iid(struct storage * s);
+iid_t				storage_get_max_accepted_iid(struct storage* s);
+iid_t				storage_get_chosen_iid(struct storage* s);
+void				storage_save_chosen_iid(struct storage* s, iid_t iid);
 
 #endif
 
@@ -1,40 +1,203 @@
 #include "tcp_receiver.h"
 #include "libpaxos_message.h"
+#include "tcp_recvbuf.h"
+#include "tcp_sendbuf.h"
+#include "spsc_ring.h"
+#include "uring.h"
+#include "khash.h"
 
 #include <errno.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
 #include <arpa/inet.h>
 #include <event2/listener.h>
 #include <event2/buffer.h>
 
-static void set_sockaddr_in(struct sockaddr_in* sin, int port)
+/*̵̵߳߳Ķг*/
+#define RECEIVER_THREAD_QUEUE	4096
+/*߳һ¼صദϢһ߳ռס߳*/
+#define RECEIVER_THREAD_BATCH	256
+/*ͣȡ֮(΢)*/
+#define RECEIVER_RESUME_CHECK	1000
+
+enum
+{
+	item_open,
+	item_msg,
+	item_close,
+};
+
+/*̵߳̽߳¼ͬһ̵߳¼˳ӵcloseһϢ֮*/
+struct receiver_item
+{
+	int					kind;
+	struct bufferevent*	bev;
+	paxos_msg			msg;
+	char				data[0];
+};
+
+struct receiver_thread
+{
+	struct tcp_receiver*	r;
+	pthread_t				thread;
+	struct event_base*		base;
+	struct evconnlistener*	listener;
+	struct carray*			bevs;		/*̵߳ӣ̷ֻ߳*/
+	struct carray*			pending;	/*ʱûܷopen/close¼*/
+	struct spsc_ring*		ring;		/*߳->߳*/
+	int						efd;		/*eventfd¼ʱѺ߳*/
+	struct event*			notify_ev;	/*߳efdĶ¼*/
+	struct event*			resume_ev;	/*߳ϵԶʱ*/
+	int						paused;
+};
+
+/*һӵ״̬peer_helloʱӹرʱɾ*/
+struct receiver_conn
+{
+	int		role;	/*paxos_role*/
+	int		slow;	/*peer-queue-highpeer-queue-low֮ǰϢ*/
+};
+
+KHASH_MAP_INIT_INT64(conn, struct receiver_conn);
+
+struct receiver_conns
+{
+	khash_t(conn)*	map;
+};
+
+static void on_error(struct bufferevent *bev, short events, void* arg);
+static void on_thread_error(struct bufferevent* bev, short events, void* arg);
+
+static void log_accept(struct tcp_receiver* r, struct sockaddr* addr)
 {
-	memset(sin, 0, sizeof(struct sockaddr_in));
+	if(addr->sa_family == AF_INET)
+		paxos_log_info("Accepted connection from %s:%d", inet_ntoa(((struct sockaddr_in*)addr)->sin_addr), ntohs(((struct sockaddr_in*)addr)->sin_port));
+	else
+		paxos_log_info("Accepted connection on %s", r->addr.desc);
+}
 
-	sin->sin_family = AF_INET;
-	sin->sin_addr.s_addr = htonl(0);
-	sin->sin_port = htons(port);
+/*unix socketļϴ˳ʱ£bind֮ǰɾ*/
+static void unlink_unix_path(struct transport_addr* ta)
+{
+	if(ta->type == transport_unix)
+		unlink(((struct sockaddr_un *)&ta->sa)->sun_path);
 }
 
-static void on_read(struct bufferevent* bev, void* arg)
+static int match_bufferevent(void* arg, void* item);
+
+static struct carray* remove_bufferevent(struct carray* a, struct bufferevent* bev)
 {
-	size_t len;
-	paxos_msg msg;
-	struct evbuffer* in;
-	struct tcp_receiver* r = (struct tcp_receiver *)arg;
+	struct carray* tmp = carray_reject(a, match_bufferevent, bev);
+	carray_free(a);
+	return tmp;
+}
+
+static struct receiver_conns* receiver_conns_new(void)
+{
+	struct receiver_conns* c = (struct receiver_conns *)malloc(sizeof(struct receiver_conns));
+	c->map = kh_init(conn);
+	return c;
+}
+
+static void receiver_conns_free(struct receiver_conns* c)
+{
+	kh_destroy(conn, c->map);
+	free(c);
+}
+
+/*ûм¼ʱNULL*/
+static struct receiver_conn* receiver_conn_get(struct tcp_receiver* r, struct bufferevent* bev)
+{
+	khiter_t k = kh_get(conn, r->conns->map, (khint64_t)(uintptr_t)bev);
+	return k == kh_end(r->conns->map) ? NULL : &kh_value(r->conns->map, k);
+}
+
+static struct receiver_conn* receiver_conn_put(struct tcp_receiver* r, struct bufferevent* bev)
+{
+	int rv;
+	khiter_t k = kh_put(conn, r->conns->map, (khint64_t)(uintptr_t)bev, &rv);
+
+	if(rv != 0)
+		memset(&kh_value(r->conns->map, k), 0, sizeof(struct receiver_conn));
+	return &kh_value(r->conns->map, k);
+}
 
-	/*ȡpaxos msgǶ*/
-	in = bufferevent_get_input(bev);
+/*ӹرʱеȥ*/
+static void receiver_conn_remove(struct tcp_receiver* r, struct bufferevent* bev)
+{
+	khiter_t k = kh_get(conn, r->conns->map, (khint64_t)(uintptr_t)bev);
+
+	if(k == kh_end(r->conns->map))
+		return;
+
+	if(kh_value(r->conns->map, k).role == role_proposer)
+		r->proposers = remove_bufferevent(r->proposers, bev);
+	else if(kh_value(r->conns->map, k).role == role_learner)
+		r->learners = remove_bufferevent(r->learners, bev);
+	kh_del(conn, r->conns->map, k);
+}
 
-	while((len = evbuffer_get_length(in)) > sizeof(paxos_msg)){
-		evbuffer_copyout(in, &msg, sizeof(paxos_msg));
-		if (len < PAXOS_MSG_SIZE((&msg)))
-			return;
+/*¼Ľɫpeer_helloreceiverϲص*/
+static void on_hello(struct tcp_receiver* r, struct bufferevent* bev, paxos_msg* msg, void* body)
+{
+	peer_hello h;
+	struct receiver_conn* c;
 
-		r->callback(bev, r->arg);
+	if(msg->data_size != sizeof(peer_hello)){
+		paxos_log_error("Invalid hello size %u", (unsigned)msg->data_size);
+		return;
 	}
+	memcpy(&h, body, sizeof(peer_hello));
+
+	receiver_conn_remove(r, bev);
+	c = receiver_conn_put(r, bev);
+	c->role = h.role;
+	if(h.role == role_proposer)
+		carray_push_back(r->proposers, bev);
+	else if(h.role == role_learner)
+		carray_push_back(r->learners, bev);
+
+	paxos_log_debug("Peer hello role %d id %d", h.role, h.id);
+}
+
+/*һϵϢrecvbuf_dispatchĻص*/
+struct receiver_dispatch
+{
+	struct tcp_receiver*	r;
+	struct bufferevent*		bev;
+};
+
+static void receiver_dispatch_msg(paxos_msg* msg, void* body, void* arg)
+{
+	struct receiver_dispatch* d = (struct receiver_dispatch *)arg;
+
+	if(msg->type == peer_hellos)
+		on_hello(d->r, d->bev, msg, body);
+	else
+		d->r->msg_callback(d->bev, msg, body, d->r->arg);
+}
+
+static void on_read(struct bufferevent* bev, void* arg)
+{
+	int ret;
+	struct receiver_dispatch d;
+
+	d.r = (struct tcp_receiver *)arg;
+	d.bev = bev;
+
+	/*ζϢ(ŷһȡ)Ӧϲһŷⷢ*/
+	sendbuf_cork();
+	ret = recvbuf_dispatch(bufferevent_get_input(bev), receiver_dispatch_msg, &d);
+	sendbuf_uncork();
+
+	/*ϰ汾ͬĶԶ޷ͨuncorkݴӦд֮ٶϿ*/
+	if(ret < 0)
+		on_error(bev, BEV_EVENT_ERROR, d.r);
 }
 
 static int match_bufferevent(void* arg, void* item)
@@ -45,19 +208,23 @@ static int match_bufferevent(void* arg, void* item)
 static void on_error(struct bufferevent *bev, short events, void* arg)
 {
 	struct tcp_receiver* r = (struct tcp_receiver *)arg;
-	if(events & (BEV_EVENT_EOF)){
-		struct carray* tmp = carray_reject(r->bevs, match_bufferevent, bev); /*˵bev¼*/
-		carray_free(r->bevs);
-		r->bevs = tmp;
+	if(events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)){
+		r->bevs = remove_bufferevent(r->bevs, bev); /*˵bev¼*/
+		receiver_conn_remove(r, bev);
+		if(r->close_callback != NULL)
+			r->close_callback(bev, r->arg);
+		sendbuf_forget(bev);
 		bufferevent_free(bev);
 	}
 }
 
-static void on_accept(struct evconnlistener* l, evutil_socket_t* fd, struct sockaddr* addr, int socklen, void *arg)
+static void on_accept(struct evconnlistener* l, evutil_socket_t fd, struct sockaddr* addr, int socklen, void *arg)
 {
 	struct tcp_receiver* r = arg;
 	struct event_base* b = evconnlistener_get_base(l);
-	struct bufferevent *bev = bufferevent_socket_new(b, fd, BEV_OPT_CLOSE_ON_FREE);
+	struct bufferevent *bev = transport_accept(b, &r->addr, fd, BEV_OPT_CLOSE_ON_FREE);
+	if(bev == NULL)
+		return;
 	/*ö¼ʹ*/
 	bufferevent_setcb(bev, on_read, NULL, on_error, arg);
 	/*üӵsocket¼*/
@@ -65,7 +232,198 @@ static void on_accept(struct evconnlistener* l, evutil_socket_t* fd, struct sock
 	/*ӵ¼*/
 	carray_push_back(r->bevs, bev);
 
-	paxos_log_info("Accepted connection from %s:%d", inet_ntoa(((struct sockaddr_in*)addr)->sin_addr), ntohs(((struct sockaddr_in*)addr)->sin_port));
+	log_accept(r, addr);
+}
+
+static struct receiver_item* receiver_item_new(int kind, struct bufferevent* bev, paxos_msg* msg, void* body)
+{
+	size_t size = msg != NULL ? msg->data_size : 0;
+	struct receiver_item* item = (struct receiver_item *)malloc(sizeof(struct receiver_item) + size);
+
+	item->kind = kind;
+	item->bev = bev;
+	if(msg != NULL){
+		item->msg = *msg;
+		memcpy(item->data, body, size);
+	}
+
+	return item;
+}
+
+static void receiver_thread_notify(struct receiver_thread* t)
+{
+	uint64_t one = 1;
+	if(write(t->efd, &one, sizeof(one)) != sizeof(one))
+		paxos_log_error("Failed to notify the receiver core thread: %s", strerror(errno));
+}
+
+static void receiver_thread_pause(struct receiver_thread* t)
+{
+	struct timeval tv = {0, RECEIVER_RESUME_CHECK};
+	if(!t->paused){
+		t->paused = 1;
+		event_add(t->resume_ev, &tv);
+	}
+}
+
+/*open/close¼ܶʱȷŵpending˳*/
+static void receiver_thread_push_event(struct receiver_thread* t, int kind, struct bufferevent* bev)
+{
+	struct receiver_item* item = receiver_item_new(kind, bev, NULL, NULL);
+
+	if(carray_count(t->pending) > 0 || spsc_ring_push(t->ring, item) != 0){
+		carray_push_back(t->pending, item);
+		receiver_thread_pause(t);
+		return;
+	}
+
+	receiver_thread_notify(t);
+}
+
+/*߳: ֡תֽƵУ뻺Ϣ漴batch_msgsŷΪһɺ̲߳*/
+static void on_thread_read(struct bufferevent* bev, void* arg)
+{
+	int ret, pushed = 0;
+	void* body;
+	paxos_msg msg;
+	struct receiver_thread* t = (struct receiver_thread *)arg;
+	struct evbuffer* in = bufferevent_get_input(bev);
+
+	while((ret = recvbuf_next_msg(in, &msg)) > 0){
+		/*ж϶ǷϢpeek֮ٷŻ뻺*/
+		if(carray_count(t->pending) > 0 || spsc_ring_count(t->ring) >= spsc_ring_size(t->ring)){
+			bufferevent_disable(bev, EV_READ);
+			receiver_thread_pause(t);
+			break;
+		}
+
+		body = recvbuf_peek_msg(in, &msg);
+		spsc_ring_push(t->ring, receiver_item_new(item_msg, bev, &msg, body));
+		recvbuf_drain_msg(in, &msg);
+		pushed++;
+	}
+
+	if(pushed > 0)
+		receiver_thread_notify(t);
+
+	/*ϰ汾ͬӶϿһ*/
+	if(ret < 0)
+		on_thread_error(bev, BEV_EVENT_ERROR, t);
+}
+
+/*߳: ֹֻͣдɺ̴֮߳ǰϢͷ*/
+static void on_thread_error(struct bufferevent* bev, short events, void* arg)
+{
+	struct receiver_thread* t = (struct receiver_thread *)arg;
+	if(events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)){
+		bufferevent_disable(bev, EV_READ|EV_WRITE);
+		t->bevs = remove_bufferevent(t->bevs, bev);
+		receiver_thread_push_event(t, item_close, bev);
+	}
+}
+
+static void on_thread_accept(struct evconnlistener* l, evutil_socket_t fd, struct sockaddr* addr, int socklen, void *arg)
+{
+	struct receiver_thread* t = arg;
+	/*̻߳uncorkʱдҪ*/
+	struct bufferevent *bev = transport_accept(t->base, &t->r->addr, fd, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
+	if(bev == NULL)
+		return;
+
+	bufferevent_setcb(bev, on_thread_read, NULL, on_thread_error, t);
+	bufferevent_enable(bev, EV_READ|EV_WRITE);
+	carray_push_back(t->bevs, bev);
+	receiver_thread_push_event(t, item_open, bev);
+
+	log_accept(t->r, addr);
+}
+
+/*߳: пռȷѹopen/close¼ټȡͣ*/
+static void on_thread_resume(evutil_socket_t fd, short event, void* arg)
+{
+	int i, pushed = 0;
+	struct receiver_thread* t = (struct receiver_thread *)arg;
+
+	t->paused = 0;
+	while(carray_count(t->pending) > 0 && spsc_ring_push(t->ring, carray_front(t->pending)) == 0){
+		carray_pop_front(t->pending);
+		pushed++;
+	}
+	if(pushed > 0)
+		receiver_thread_notify(t);
+
+	if(carray_count(t->pending) > 0){
+		receiver_thread_pause(t);
+		return;
+	}
+
+	for(i = 0; i < carray_count(t->bevs); i++){
+		struct bufferevent* bev = carray_at(t->bevs, i);
+		bufferevent_enable(bev, EV_READ);
+		on_thread_read(bev, t);
+	}
+}
+
+static void* receiver_thread_main(void* arg)
+{
+	struct receiver_thread* t = (struct receiver_thread *)arg;
+	event_base_loop(t->base, EVLOOP_NO_EXIT_ON_EMPTY);
+	return NULL;
+}
+
+/*߳: ˳һ߳̽¼*/
+static void receiver_handle_item(struct tcp_receiver* r, struct receiver_item* item)
+{
+	struct receiver_dispatch d;
+
+	switch(item->kind){
+	case item_open:
+		carray_push_back(r->bevs, item->bev);
+		break;
+
+	case item_msg:
+		d.r = r;
+		d.bev = item->bev;
+		/*̰߳ŷϢ*/
+		if(item->msg.type != batch_msgs)
+			receiver_dispatch_msg(&item->msg, item->data, &d);
+		else if(recvbuf_foreach_batch(item->data, item->msg.data_size, receiver_dispatch_msg, &d) < 0)
+			paxos_log_error("Dropped malformed batch of %u bytes", (unsigned)item->msg.data_size);
+		break;
+
+	case item_close:
+		r->bevs = remove_bufferevent(r->bevs, item->bev);
+		receiver_conn_remove(r, item->bev);
+		if(r->close_callback != NULL)
+			r->close_callback(item->bev, r->arg);
+		/*on_thread_notifycorkУϢӦѾݴ棬ȶͷ*/
+		sendbuf_forget(item->bev);
+		bufferevent_free(item->bev);
+		break;
+	}
+}
+
+static void on_thread_notify(evutil_socket_t fd, short event, void* arg)
+{
+	int n;
+	uint64_t count;
+	struct receiver_item* item;
+	struct receiver_thread* t = (struct receiver_thread *)arg;
+
+	if(read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		paxos_log_error("Failed to read the receiver eventfd: %s", strerror(errno));
+
+	/*һϢӦϲuncorkʱÿֻһ*/
+	sendbuf_cork();
+	for(n = 0; n < RECEIVER_THREAD_BATCH && (item = spsc_ring_pop(t->ring)) != NULL; n++){
+		receiver_handle_item(t->r, item);
+		free(item);
+	}
+	sendbuf_uncork();
+
+	/*ûģ̵߳¼ִ*/
+	if(n == RECEIVER_THREAD_BATCH)
+		event_active(t->notify_ev, EV_READ, 0);
 }
 
 static void on_listener_error(struct evconnlistener* l, void* arg)
@@ -77,31 +435,146 @@ static void on_listener_error(struct evconnlistener* l, void* arg)
 	event_base_loopexit(base, NULL);
 }
 
-struct tcp_receiver* tcp_receiver_new(struct event_base* b, int port, bufferevent_data_cb cb, void* arg)
+struct tcp_receiver* tcp_receiver_new(struct event_base* b, struct transport_addr* addr, tcp_receiver_msg_cb cb, void* arg)
 {
 	struct tcp_receiver* r;
-	struct sockaddr_in sin;
 	unsigned flags = LEV_OPT_CLOSE_ON_EXEC | LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE;
 
 	r = malloc(sizeof(struct tcp_receiver));
-	set_sockaddr_in(&sin, port);
-	r->callback = cb;
+	r->addr = *addr;
+	r->msg_callback = cb;
+	r->close_callback = NULL;
 	r->arg = arg;
+	r->threads = NULL;
+	r->thread_count = 0;
 	/*libevent listenerbind˿*/
-	r->listener = evconnlistener_new_bind(b, on_accept, r, flags,	-1, (struct sockaddr*)&sin, sizeof(sin));
+	unlink_unix_path(addr);
+	r->listener = evconnlistener_new_bind(b, on_accept, r, flags,	-1, (struct sockaddr*)&addr->sa, addr->len);
 	assert(r->listener != NULL);
 	/*listen error ص*/
 	evconnlistener_set_error_cb(r->listener, on_listener_error);
 
 	r->bevs = carray_new(10);
+	r->proposers = carray_new(10);
+	r->learners = carray_new(10);
+	r->conns = receiver_conns_new();
 
-	paxos_log_info("Listening on port %d", port);
+	paxos_log_info("Listening on %s", addr->desc);
 
 	return r;
 }
+struct tcp_receiver* tcp_receiver_new_threads(struct event_base* b, struct transport_addr* addr, int threads, tcp_receiver_msg_cb cb, void* arg)
+{
+	int i;
+	struct tcp_receiver* r;
+	unsigned flags = LEV_OPT_CLOSE_ON_EXEC | LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE;
+
+	r = malloc(sizeof(struct tcp_receiver));
+	r->addr = *addr;
+	if(addr->type == transport_tcp)
+		flags |= LEV_OPT_REUSEABLE_PORT;
+	r->msg_callback = cb;
+	r->close_callback = NULL;
+	r->arg = arg;
+	r->listener = NULL;
+	r->bevs = carray_new(10);
+	r->proposers = carray_new(10);
+	r->learners = carray_new(10);
+	r->conns = receiver_conns_new();
+	r->thread_count = threads;
+	r->threads = (struct receiver_thread *)malloc(sizeof(struct receiver_thread) * threads);
+
+	for(i = 0; i < threads; i++){
+		struct receiver_thread* t = &r->threads[i];
+
+		t->r = r;
+		t->base = event_base_new();
+		t->bevs = carray_new(10);
+		t->pending = carray_new(10);
+		t->ring = spsc_ring_new(RECEIVER_THREAD_QUEUE);
+		t->paused = 0;
+		t->resume_ev = evtimer_new(t->base, on_thread_resume, t);
+		t->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		assert(t->efd >= 0);
+		t->notify_ev = event_new(b, t->efd, EV_READ | EV_PERSIST, on_thread_notify, t);
+		event_add(t->notify_ev, NULL);
+
+		/*TCPÿ߳һͬһ˿ڵlistenerں֮ӡ
+		  unix socket֧SO_REUSEPORT̼߳ͬһsocketĸ*/
+		if(addr->type == transport_tcp || i == 0){
+			unlink_unix_path(addr);
+			t->listener = evconnlistener_new_bind(t->base, on_thread_accept, t, flags, -1, (struct sockaddr*)&addr->sa, addr->len);
+		}
+		else
+			t->listener = evconnlistener_new(t->base, on_thread_accept, t, flags, -1, dup(evconnlistener_get_fd(r->threads[0].listener)));
+		assert(t->listener != NULL);
+		evconnlistener_set_error_cb(t->listener, on_listener_error);
+
+		pthread_create(&t->thread, NULL, receiver_thread_main, t);
+	}
+
+	paxos_log_info("Listening on %s with %d network threads", addr->desc, threads);
+
+	return r;
+}
+
+void tcp_receiver_set_close_cb(struct tcp_receiver* r, tcp_receiver_close_cb cb)
+{
+	r->close_callback = cb;
+}
+
+static void receiver_thread_free(struct receiver_thread* t)
+{
+	int i;
+	struct receiver_item* item;
+
+	event_base_loopexit(t->base, NULL);
+	pthread_join(t->thread, NULL);
+
+	/*߳Ѿ˳ʣµ¼ֱӶͳһͷ*/
+	while((item = spsc_ring_pop(t->ring)) != NULL){
+		if(item->kind == item_close)
+			bufferevent_free(item->bev);
+		free(item);
+	}
+	while(carray_count(t->pending) > 0){
+		item = carray_pop_front(t->pending);
+		if(item->kind == item_close)
+			bufferevent_free(item->bev);
+		free(item);
+	}
+
+	for(i = 0; i < carray_count(t->bevs); i++)
+		bufferevent_free(carray_at(t->bevs, i));
+
+	evconnlistener_free(t->listener);
+	event_free(t->resume_ev);
+	event_free(t->notify_ev);
+	uring_free(t->base);
+	event_base_free(t->base);
+	close(t->efd);
+	spsc_ring_free(t->ring);
+	carray_free(t->bevs);
+	carray_free(t->pending);
+}
+
 void tcp_receiver_free(struct tcp_receiver* r)
 {
 	int i;
+
+	if(r->threads != NULL){
+		for(i = 0; i < r->thread_count; i++)
+			receiver_thread_free(&r->threads[i]);
+		free(r->threads);
+
+		carray_free(r->bevs);
+		carray_free(r->proposers);
+		carray_free(r->learners);
+		receiver_conns_free(r->conns);
+		free(r);
+		return;
+	}
+
 	/*ͷżӵ¼*/
 	for (i = 0; i < carray_count(r->bevs); ++i)
 		bufferevent_free(carray_at(r->bevs, i));
@@ -109,6 +582,9 @@ void tcp_receiver_free(struct tcp_receiver* r)
 	evconnlistener_free(r->listener);
 
 	carray_free(r->bevs);
+	carray_free(r->proposers);
+	carray_free(r->learners);
+	receiver_conns_free(r->conns);
 	free(r);
 }
 
@@ -116,3 +592,54 @@ struct carray* tcp_receiver_get_events(struct tcp_receiver* r)
 {
 	return r->bevs;
 }
+
+struct carray* tcp_receiver_get_proposers(struct tcp_receiver* r)
+{
+	return r->proposers;
+}
+
+struct carray* tcp_receiver_get_learners(struct tcp_receiver* r)
+{
+	return r->learners;
+}
+
+int tcp_receiver_backlog(struct tcp_receiver* r)
+{
+	int i, n = 0;
+	for(i = 0; i < r->thread_count; i++)
+		n += spsc_ring_count(r->threads[i].ring);
+	return n;
+}
+
+int tcp_receiver_get_role(struct tcp_receiver* r, struct bufferevent* bev)
+{
+	struct receiver_conn* c = receiver_conn_get(r, bev);
+	return c != NULL ? c->role : role_unknown;
+}
+
+struct bufferevent* tcp_receiver_get_buffer(struct tcp_receiver* r, struct bufferevent* bev)
+{
+	struct evbuffer* out = bufferevent_get_output(bev);
+	size_t queued = evbuffer_get_length(out);
+	struct receiver_conn* c = receiver_conn_get(r, bev);
+
+	if(c == NULL)
+		c = receiver_conn_put(r, bev);
+
+	/*Ͽڹر֮ǰһֱ*/
+	if(c->slow && queued < (size_t)paxos_config.peer_queue_low && !paxos_config.peer_slow_disconnect)
+		c->slow = 0;
+
+	if(!c->slow && queued >= (size_t)paxos_config.peer_queue_high){
+		paxos_log_error("Connection is too slow, %u bytes queued", (unsigned)queued);
+		c->slow = 1;
+		if(paxos_config.peer_slow_disconnect){
+			/*ŶӵݶԶɲָ߿ڱ飬رƳٵص֮*/
+			evbuffer_drain(out, queued);
+			bufferevent_disable(bev, EV_READ | EV_WRITE);
+			bufferevent_trigger_event(bev, BEV_EVENT_ERROR, BEV_TRIG_DEFER_CALLBACKS);
+		}
+	}
+
+	return c->slow ? NULL : bev;
+}
@@ -3,23 +3,61 @@
 
 #include "evpaxos.h"
 #include "carray.h"
+#include "libpaxos_message.h"
+#include "transport.h"
 #include "config.h"
 #include <event2/event.h>
 #include <event2/bufferevent.h>
 
+/*ϢصÿϢ(batch_msgsŷеÿϢ)һΣbodyֽϢ壬ֻڻصڼЧ
+  peer_helloreceiverص*/
+typedef void (*tcp_receiver_msg_cb)(struct bufferevent* bev, paxos_msg* msg, void* body, void* arg);
+/*ӹرգصغbevͷţϲҪ*/
+typedef void (*tcp_receiver_close_cb)(struct bufferevent* bev, void* arg);
+
+struct receiver_thread;
+struct receiver_conns;
+
 struct tcp_receiver
 {
-	bufferevent_data_cb callback;
+	tcp_receiver_msg_cb msg_callback;
+	tcp_receiver_close_cb close_callback;
 	void* arg;
 	struct evconnlistener* listener;
 	struct carray* bevs;
+	struct carray* proposers;	/*ͨpeer_helloΪproposerӣbevsӼ*/
+	struct carray* learners;	/*ͨpeer_helloΪlearnerӣbevsӼ*/
+	struct receiver_conns* conns;	/*bevӵ״̬(Ľɫ)ֻڻص̷߳*/
+	struct receiver_thread* threads;
+	int thread_count;
+	struct transport_addr addr;	/*ִַܵ䷽ʽ*/
 };
-/*һtcp receiver*/
-struct tcp_receiver* tcp_receiver_new(struct event_base* b, int port, bufferevent_data_cb cb, void* arg);
+/*һtcp receiverصcorkΧִУһζϢӦϲһŷ*/
+struct tcp_receiver* tcp_receiver_new(struct event_base* b, struct transport_addr* addr, tcp_receiver_msg_cb cb, void* arg);
+/*һ̵߳tcp receiverthreads̸߳event_baseSO_REUSEPORTlistener
+  ӵĶд֡ͽ룬Ϣͨнbڵ̰߳˳cb
+  صcorkΧִУӵдcorkΧ(uncorkʱһν߳)
+  ߳̿߳д̵߳ӣ߱ڴb֮ǰevthread_use_pthreads()*/
+struct tcp_receiver* tcp_receiver_new_threads(struct event_base* b, struct transport_addr* addr, int threads, tcp_receiver_msg_cb cb, void* arg);
+/*ӹرյĻصϢصͬһ̵߳*/
+void tcp_receiver_set_close_cb(struct tcp_receiver* r, tcp_receiver_close_cb cb);
 /*һtcp recevier*/
 void tcp_receiver_free(struct tcp_receiver* r);
 /*ȡtcp recevier¼*/
-struct carray* tcp_receiver_get_events(struct tcp_recevier* r);
+struct carray* tcp_receiver_get_events(struct tcp_receiver* r);
+/*peer_helloĽɫȡӣûɫӲ*/
+struct carray* tcp_receiver_get_proposers(struct tcp_receiver* r);
+struct carray* tcp_receiver_get_learners(struct tcp_receiver* r);
+/*ͨpeer_helloĽɫ(paxos_role)O(1)*/
+int tcp_receiver_get_role(struct tcp_receiver* r, struct bufferevent* bev);
+/*peers_get_bufferһpeer-queue-high/lowԶ˹ʱNULL߶Ϣ
+  peer-slow-disconnectʱϿӣرƳٵֻص֮󣬱ʱԵ*/
+struct bufferevent* tcp_receiver_get_buffer(struct tcp_receiver* r, struct bufferevent* bev);
+/*peers_get_bufferһpeer-queue-high/lowԶ˹ʱNULL߶Ϣ
+  peer-slow-disconnectʱϿӣڱֻص֮رգʱԵ*/
+struct bufferevent* tcp_receiver_get_buffer(struct tcp_receiver* r, struct bufferevent* bev);
+/*߳Ѿ롢ûнصϢ߳ģʽΪ0*/
+int tcp_receiver_backlog(struct tcp_receiver* r);
 
 #endif
 
@@ -0,0 +1,111 @@
+#include "tcp_recvbuf.h"
+#include <string.h>
+
+/*Զʹõϰ汾peer_helloĲڸ汾в䣬İ汾Ϣ֡ͷİ汾*/
+static int recvbuf_msg_version(struct evbuffer* in, paxos_msg* msg)
+{
+	peer_hello h;
+
+	if(msg->type != peer_hellos || msg->data_size < sizeof(peer_hello))
+		return msg->version;
+
+	memcpy(&h, evbuffer_pullup(in, PAXOS_MSG_SIZE(msg)) + sizeof(paxos_msg), sizeof(peer_hello));
+	return (int32_t)le32toh(h.version);
+}
+
+int recvbuf_next_msg(struct evbuffer* in, paxos_msg* msg)
+{
+	unsigned char* p;
+	size_t len;
+	int version;
+
+	len = evbuffer_get_length(in);
+	if(len < sizeof(paxos_msg))
+		return 0;
+
+	/*ϢͷСƳǶ*/
+	p = evbuffer_pullup(in, sizeof(paxos_msg));
+	memcpy(msg, p, sizeof(paxos_msg));
+	msg->data_size = le32toh(msg->data_size);
+	if(len < PAXOS_MSG_SIZE(msg))
+		return 0;
+
+	/*ֶ֡ڸ汾λò䣬ʶİ汾޷Ϣ壬֮ϢҲһڻɵ߶Ͽ*/
+	version = recvbuf_msg_version(in, msg);
+	if(version != PAXOS_WIRE_VERSION){
+		paxos_log_error("Peer uses wire version %d, expected %d", version, PAXOS_WIRE_VERSION);
+		return -1;
+	}
+
+	return 1;
+}
+
+/*recvbuf_next_msg1֮ȡϢ*/
+static void* recvbuf_body(struct evbuffer* in, paxos_msg* msg)
+{
+	unsigned char* p = evbuffer_pullup(in, PAXOS_MSG_SIZE(msg));
+
+	/*ϢԭתֽͬһϢֻpeekһΡŷڴϢʱת*/
+	paxos_msg_swap(msg->type, p + sizeof(paxos_msg));
+	return p + sizeof(paxos_msg);
+}
+
+void* recvbuf_peek_msg(struct evbuffer* in, paxos_msg* msg)
+{
+	if(recvbuf_next_msg(in, msg) <= 0)
+		return NULL;
+
+	return recvbuf_body(in, msg);
+}
+
+void recvbuf_drain_msg(struct evbuffer* in, paxos_msg* msg)
+{
+	evbuffer_drain(in, PAXOS_MSG_SIZE(msg));
+}
+
+int recvbuf_foreach_batch(void* body, size_t size, recvbuf_msg_cb cb, void* arg)
+{
+	int n, count = 0;
+	size_t off;
+	paxos_msg msg, sub;
+	unsigned char* p = body;
+
+	for(off = 0; off < size; off += n + msg.data_size){
+		n = paxos_sub_header_decode(p + off, size - off, &msg);
+		if(n == 0 || msg.type == batch_msgs || msg.data_size > size - off - n)
+			return -1;
+	}
+
+	for(off = 0; off < size; off += n + msg.data_size){
+		n = paxos_sub_header_decode(p + off, size - off, &msg);
+		paxos_msg_swap(msg.type, p + off + n);
+		/*صõǸĶӰ*/
+		sub = msg;
+		cb(&sub, p + off + n, arg);
+		count++;
+	}
+
+	return count;
+}
+
+int recvbuf_dispatch(struct evbuffer* in, recvbuf_msg_cb cb, void* arg)
+{
+	int ret, n, count = 0;
+	void* body;
+	paxos_msg msg;
+
+	while((ret = recvbuf_next_msg(in, &msg)) > 0){
+		body = recvbuf_body(in, &msg);
+		if(msg.type != batch_msgs){
+			cb(&msg, body, arg);
+			count++;
+		}
+		else if((n = recvbuf_foreach_batch(body, msg.data_size, cb, arg)) >= 0)
+			count += n;
+		else
+			paxos_log_error("Dropped malformed batch of %u bytes", (unsigned)msg.data_size);
+		recvbuf_drain_msg(in, &msg);
+	}
+
+	return ret < 0 ? -1 : count;
+}
@@ -0,0 +1,28 @@
+#ifndef __TCP_RECVBUF_H_
+#define __TCP_RECVBUF_H_
+
+#include <event2/buffer.h>
+
+#include "evpaxos.h"
+#include "libpaxos_message.h"
+
+/*뻺ϢʱֽϢͷƵmsg1Ϣ塣
+  Զ˵ϰ汾(֡ͷpeer_hello)ͬʱ-1ϢڻӦöϿ*/
+int		recvbuf_next_msg(struct evbuffer* in, paxos_msg* msg);
+/*뻺ϢʱԭصϢָ(ѾתΪֽ)ϢͷƵmsgûзNULL
+  ֻϢԽchunkʱevbuffer_pullupŻḴƣָrecvbuf_drain_msg֮ǰЧ
+  ÿϢֻpeekһΡ汾ʱҲNULL*/
+void*	recvbuf_peek_msg(struct evbuffer* in, paxos_msg* msg);
+/*recvbuf_peek_msgصϢ*/
+void	recvbuf_drain_msg(struct evbuffer* in, paxos_msg* msg);
+
+/*ϢĻصbodyֽԭϢ壬ֻڻصڼЧ*/
+typedef void (*recvbuf_msg_cb)(paxos_msg* msg, void* body, void* arg);
+/*뻺Ϣbatch_msgsŷȡһΣϢ˳cb
+  شϢԶ˵ϰ汾ͬʱ-1recvbuf_next_msgһϢڻʽԵŷ¼*/
+int		recvbuf_dispatch(struct evbuffer* in, recvbuf_msg_cb cb, void* arg);
+/*ŷϢ(recvbuf_peek_msgȡģûתֽ)еϢcbϢ
+  ȼŷ⣬ʽʱ-1һϢҲ*/
+int		recvbuf_foreach_batch(void* body, size_t size, recvbuf_msg_cb cb, void* arg);
+
+#endif
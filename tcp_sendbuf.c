@@ -1,26 +1,186 @@
 #include "tcp_sendbuf.h"
+#include <string.h>
+#include <stdlib.h>
+#include <event2/buffer.h>
 #include <event2/bufferevent.h>
 
-/*һpaxos msgͷϢ͵*/
-static void add_paxos_header(struct bufferevent* bev, paxos_msg_code c, size_t s)
+/*corkڼÿӵϢϢʽݴ棬uncorkʱbatch_msgsŷ(ֻһʱͨϢ֡)
+  һƵbufferevent*/
+struct sendbuf_stage
+{
+	struct bufferevent*	bev;
+	struct evbuffer*	out;	/*Ѿõ֡*/
+	struct evbuffer*	batch;	/*ûзڵϢ*/
+	int					count;	/*batchϢĸ*/
+};
+
+/*һŷôֽڣշҪŷŵڴﴦʱȷڣϢŵһŷ*/
+#define SENDBUF_BATCH_MAX	(64 * 1024)
+
+/*cork״ֻ̬ڵõ߳(¼ѭ)*/
+static __thread int						cork_depth;
+static __thread struct sendbuf_stage*	stages;
+static __thread int						stage_count;
+static __thread int						stage_size;	/*Ѿݴ滺uncork*/
+
+/*corkڼӵݴ*/
+static struct sendbuf_stage* sendbuf_stage_of(struct bufferevent* bev)
+{
+	int i;
+
+	for(i = 0; i < stage_count; i++){
+		if(stages[i].bev == bev)
+			return &stages[i];
+	}
+
+	if(stage_count == stage_size){
+		stage_size = stage_size == 0 ? 16 : stage_size * 2;
+		stages = (struct sendbuf_stage*)realloc(stages, sizeof(struct sendbuf_stage) * stage_size);
+		for(i = stage_count; i < stage_size; i++){
+			stages[i].out = evbuffer_new();
+			stages[i].batch = evbuffer_new();
+		}
+	}
+
+	stages[stage_count].bev = bev;
+	stages[stage_count].count = 0;
+	return &stages[stage_count++];
+}
+
+/*Ϣͷ(hlenֽ)Ϣ()һдһ*/
+static void encode(struct evbuffer* out, const void* h, size_t hlen, paxos_msg_code c, const void* a, size_t alen, const void* b, size_t blen)
+{
+	char* p;
+	struct evbuffer_iovec v;
+
+	if(evbuffer_reserve_space(out, hlen + alen + blen, &v, 1) < 1){
+		paxos_log_error("Failed to reserve %u bytes for msg type %d", (unsigned)(hlen + alen + blen), c);
+		return;
+	}
+
+	p = v.iov_base;
+	memcpy(p, h, hlen);
+	if(alen > 0)
+		memcpy(p + hlen, a, alen);
+	if(blen > 0)
+		memcpy(p + hlen + alen, b, blen);
+	/*һϢĶ֣ԭתֽ*/
+	if(alen > 0)
+		paxos_msg_swap(c, p + hlen);
+
+	v.iov_len = hlen + alen + blen;
+	evbuffer_commit_space(out, &v, 1);
+}
+
+/*һpaxos msgͷϢϢһд*/
+void sendbuf_encode_msg(struct evbuffer* out, paxos_msg_code c, const void* a, size_t alen, const void* b, size_t blen)
 {
 	paxos_msg m;
-	m.data_size = s;
+
+	m.version = PAXOS_WIRE_VERSION;
 	m.type = c;
-	bufferevent_write(bev, &m, sizeof(paxos_msg));
+	m.data_size = htole32(alen + blen);
+	encode(out, &m, sizeof(paxos_msg), c, a, alen, b, blen);
+}
+
+void sendbuf_encode_sub(struct evbuffer* out, paxos_msg_code c, const void* a, size_t alen, const void* b, size_t blen)
+{
+	unsigned char h[PAXOS_SUB_HEADER_MAX];
+	encode(out, h, paxos_sub_header_encode(h, c, alen + blen), c, a, alen, b, blen);
+}
+
+void sendbuf_seal(struct evbuffer* batch, int count, struct evbuffer* out)
+{
+	paxos_msg h;
+	size_t len = evbuffer_get_length(batch);
+
+	if(count == 0)
+		return;
+
+	if(count == 1){
+		/*ϢͷͨϢͷϢ岻*/
+		evbuffer_drain(batch, paxos_sub_header_decode(evbuffer_pullup(batch, len < PAXOS_SUB_HEADER_MAX ? len : PAXOS_SUB_HEADER_MAX), len, &h));
+		h.data_size = htole32(h.data_size);
+	}
+	else{
+		h.version = PAXOS_WIRE_VERSION;
+		h.type = batch_msgs;
+		h.data_size = htole32(len);
+	}
+
+	/*evbuffer֮ƶchainϢ*/
+	evbuffer_add(out, &h, sizeof(paxos_msg));
+	evbuffer_add_buffer(out, batch);
+}
+
+static void send_msg(struct bufferevent* bev, paxos_msg_code c, const void* a, size_t alen, const void* b, size_t blen)
+{
+	struct sendbuf_stage* s;
+
+	if(cork_depth == 0){
+		sendbuf_encode_msg(bufferevent_get_output(bev), c, a, alen, b, blen);
+		return;
+	}
+
+	s = sendbuf_stage_of(bev);
+	if(s->count > 0 && evbuffer_get_length(s->batch) + PAXOS_SUB_HEADER_MAX + alen + blen > SENDBUF_BATCH_MAX){
+		sendbuf_seal(s->batch, s->count, s->out);
+		s->count = 0;
+	}
+
+	sendbuf_encode_sub(s->batch, c, a, alen, b, blen);
+	s->count++;
+}
+
+/*һδ(һֹ㲥)ǰãڼ䷢ͬһӵϢϲһνbuffereventǶ*/
+void sendbuf_cork(void)
+{
+	cork_depth++;
+}
+
+void sendbuf_uncork(void)
+{
+	int i;
+
+	if(cork_depth == 0 || --cork_depth > 0)
+		return;
+
+	/*ÿһŷ⣬һд*/
+	for(i = 0; i < stage_count; i++){
+		sendbuf_seal(stages[i].batch, stages[i].count, stages[i].out);
+		bufferevent_write_buffer(stages[i].bev, stages[i].out);
+	}
+
+	stage_count = 0;
+}
+
+void sendbuf_forget(struct bufferevent* bev)
+{
+	int i;
+	struct sendbuf_stage s;
+
+	for(i = 0; i < stage_count; i++){
+		if(stages[i].bev == bev){
+			/*һݴƵλãյĻŵĩβŸ*/
+			s = stages[i];
+			evbuffer_drain(s.out, evbuffer_get_length(s.out));
+			evbuffer_drain(s.batch, evbuffer_get_length(s.batch));
+			stages[i] = stages[--stage_count];
+			stages[stage_count] = s;
+			return;
+		}
+	}
 }
 
 void sendbuf_add_prepare_req(struct bufferevent* bev, prepare_req* pr)
 {
 	size_t s = PREPARE_REQ_SIZE(pr);
-	add_paxos_header(bev, prepare_reqs, s);
-	bufferevent_write(bev, pr, s);
+	send_msg(bev, prepare_reqs, pr, s, NULL, 0);
 	paxos_log_debug("Send prepare iid: %d ballot: %d", pr->iid, pr->ballot);
 }
 
 void sendbuf_add_prepare_ack(struct bufferevent* bev, acceptor_record* rec)
 {
-	size_t s;
 	prepare_ack pa;
 
 	pa.accept_id = rec->acceptor_id;
@@ -29,12 +189,7 @@ void sendbuf_add_prepare_ack(struct bufferevent* bev, acceptor_record* rec)
 	pa.value_ballot = rec->value_ballot;
 	pa.value_size = rec->value_size;
 
-	s = PREPARE_ACK_SIZE((&pa));
-	add_paxos_header(bev, prepare_acks, s);
-	bufferevent_write(bev, &pa, sizeof(prepare_ack));
-	if(pa.value_size > 0){
-		bufferevent_write(bev, rec->value, rec->value_size);
-	}
+	send_msg(bev, prepare_acks, &pa, sizeof(prepare_ack), rec->value, rec->value_size);
 
 	paxos_log_debug("Send prepare ack for inst %d ballot %d", rec->iid, rec->ballot);
 }
@@ -42,29 +197,102 @@ void sendbuf_add_prepare_ack(struct bufferevent* bev, acceptor_record* rec)
 void sendbuf_add_accept_req(struct bufferevent* bev, accept_req* ar)
 {
 	size_t s = ACCEPT_REQ_SIZE(ar);
-	add_paxos_header(bev, accept_reqs, s);
-	bufferevent_write(bev, ar, s);
+	send_msg(bev, accept_reqs, ar, s, NULL, 0);
 	paxos_log_debug("Send accept req for inst %d ballot %d", ar->iid, ar->ballot);
 }
 
 void sendbuf_add_accept_ack(struct bufferevent* bev, acceptor_record* rec)
 {
 	size_t s = ACCEPT_ACK_SIZE(rec);
-	add_paxos_header(bev, accept_acks, s);
-	bufferevent_write(bev, rec, s);
-	paxos_log_debug("Send accept ack for inst %d ballot %d", aa->iid, aa->ballot);
+	send_msg(bev, accept_acks, rec, s, NULL, 0);
+	paxos_log_debug("Send accept ack for inst %d ballot %d", rec->iid, rec->ballot);
+}
+
+/*мתѾͨ᰸learnerյֱӹرʵ*/
+void sendbuf_add_final_accept_ack(struct bufferevent* bev, accept_ack* aa)
+{
+	accept_ack fa = *aa;
+
+	fa.acceptor_id = 0;
+	fa.is_final = 1;
+	send_msg(bev, accept_acks, &fa, sizeof(accept_ack), aa->value, aa->value_size);
+	paxos_log_debug("Relay final accept ack for inst %u ballot %u", aa->iid, aa->ballot);
+}
+
+void sendbuf_add_repeat_req(struct bufferevent* bev, iid_t from, iid_t to)
+{
+	repeat_req rr;
+	size_t s = REPEAT_REQ_SIZE((&rr));
+
+	rr.from = from;
+	rr.to = to;
+	send_msg(bev, repeat_reqs, &rr, s, NULL, 0);
+	paxos_log_debug("Send repeat request for inst %u-%u", from, to);
 }
 
-void sendbuf_add_repeat_req(struct bufferevent* bev, iid_t iid)
+void sendbuf_add_max_iid_req(struct bufferevent* bev)
 {
-	add_paxos_header(bev, repeat_reqs, sizeof(iid_t));
-	bufferevent_write(bev, &iid, sizeof(iid_t));
-	paxos_log_debug("Send repeat request for inst %d", iid);
+	send_msg(bev, max_iid_reqs, NULL, 0, NULL, 0);
+	paxos_log_debug("Send max iid request");
+}
+
+void sendbuf_add_max_iid_ack(struct bufferevent* bev, max_iid_ack* ack)
+{
+	size_t s = MAX_IID_ACK_SIZE(ack);
+	send_msg(bev, max_iid_acks, ack, s, NULL, 0);
+	paxos_log_debug("Send max iid ack iid: %u ballot: %u", ack->iid, ack->ballot);
 }
 
 void paxos_submit(struct bufferevent* bev, char* value, int size)
 {
-	add_paxos_header(bev, submit, size);
-	bufferevent_write(bev, value, size);
+	send_msg(bev, submit, value, size, NULL, 0);
+}
+
+/*proposerֻҪ(acceptor_id, iid, ballot)ֵaccept ack*/
+void sendbuf_add_accept_ack_header(struct bufferevent* bev, acceptor_record* rec)
+{
+	accept_ack aa = *rec;
+
+	aa.value_size = 0;
+	send_msg(bev, accept_acks, &aa, sizeof(accept_ack), NULL, 0);
+	paxos_log_debug("Send accept ack header for inst %u ballot %u", rec->iid, rec->ballot);
+}
+
+void sendbuf_add_chosen(struct bufferevent* bev, iid_t iid, ballot_t ballot)
+{
+	chosen_msg cm;
+	size_t s = CHOSEN_MSG_SIZE((&cm));
+
+	cm.iid = iid;
+	cm.ballot = ballot;
+	send_msg(bev, chosen_msgs, &cm, s, NULL, 0);
+	paxos_log_debug("Send chosen for inst %u ballot %u", iid, ballot);
 }
 
+void sendbuf_add_chosen_upto(struct bufferevent* bev, iid_t iid)
+{
+	chosen_upto_msg cm;
+	size_t s = CHOSEN_UPTO_MSG_SIZE((&cm));
+
+	cm.iid = iid;
+	send_msg(bev, chosen_upto_msgs, &cm, s, NULL, 0);
+	paxos_log_debug("Send chosen up to inst %u", iid);
+}
+
+void sendbuf_add_peer_hello(struct bufferevent* bev, int role, int id)
+{
+	peer_hello h;
+	size_t s = PEER_HELLO_SIZE((&h));
+
+	h.version = PAXOS_WIRE_VERSION;
+	h.role = role;
+	h.id = id;
+	send_msg(bev, peer_hellos, &h, s, NULL, 0);
+	paxos_log_debug("Send hello role %d id %d", role, id);
+}
+
+void sendbuf_add_credit(struct bufferevent* bev, credit_msg* cm)
+{
+	send_msg(bev, credit_msgs, cm, CREDIT_MSG_SIZE(cm), NULL, 0);
+	paxos_log_debug("Send credit %u instances %u bytes", cm->instances, cm->bytes);
+}
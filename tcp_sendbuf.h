@@ -10,11 +10,32 @@
 #include "evpaxos.h"
 #include "libpaxos_message.h"
 
+/*corkuncork֮䷢ͬһӵϢbatch_msgsŷһд룬Ƕ*/
+void sendbuf_cork(void);
+void sendbuf_uncork(void);
+/*ͷbufferevent֮ǰãcorkڼݴϢuncorkʱдѾͷŵ*/
+void sendbuf_forget(struct bufferevent* bev);
+
+/*ϸʽһϢ(aͲתֵb)дoutcork鲥ȷӵķ*/
+void sendbuf_encode_msg(struct evbuffer* out, paxos_msg_code c, const void* a, size_t alen, const void* b, size_t blen);
+/*sendbuf_encode_msgһдbatch_msgsŷеϢsendbuf_seal*/
+void sendbuf_encode_sub(struct evbuffer* out, paxos_msg_code c, const void* a, size_t alen, const void* b, size_t blen);
+/*batchеcountϢһ֡׷ӵoutbatch漴: һϢԭͨϢ֡batch_msgsŷͷ*/
+void sendbuf_seal(struct evbuffer* batch, int count, struct evbuffer* out);
+
 void sendbuf_add_prepare_req(struct bufferevent* bev, prepare_req* pr);
 void sendbuf_add_prepare_ack(struct bufferevent* bev, acceptor_record* rec);
 void sendbuf_add_accept_req(struct bufferevent* bev, accept_req* ar);
 void sendbuf_add_accept_ack(struct bufferevent* bev, acceptor_record* rec);
-void sendbuf_add_repeat_req(struct bufferevent* bev, iid_t iid);
+void sendbuf_add_final_accept_ack(struct bufferevent* bev, accept_ack* aa);
+void sendbuf_add_accept_ack_header(struct bufferevent* bev, acceptor_record* rec);
+void sendbuf_add_repeat_req(struct bufferevent* bev, iid_t from, iid_t to);
+void sendbuf_add_max_iid_req(struct bufferevent* bev);
+void sendbuf_add_max_iid_ack(struct bufferevent* bev, max_iid_ack* ack);
+void sendbuf_add_chosen(struct bufferevent* bev, iid_t iid, ballot_t ballot);
+void sendbuf_add_chosen_upto(struct bufferevent* bev, iid_t iid);
+void sendbuf_add_peer_hello(struct bufferevent* bev, int role, int id);
+void sendbuf_add_credit(struct bufferevent* bev, credit_msg* cm);
 
 #endif
 
@@ -0,0 +1,225 @@
+/*learnerʵںͨλͼĵԪ
+  gcc -std=gnu99 -Wall -I.. -o test_learner test_learner.c ../learner.c ../paxos.c && ./test_learner*/
+#include "learner.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define ACCEPTORS	3
+#define WINDOW		128
+
+/*һackֵiidlearnerֵʱḴƣackջ*/
+static void send_ack(struct learner* l, int acceptor, iid_t iid)
+{
+	char buf[sizeof(accept_ack) + sizeof(iid_t)];
+	accept_ack* ack = (accept_ack*)buf;
+
+	ack->acceptor_id = acceptor;
+	ack->iid = iid;
+	ack->ballot = 1;
+	ack->value_ballot = 1;
+	ack->is_final = 0;
+	ack->value_size = sizeof(iid_t);
+	memcpy(ack->value, &iid, sizeof(iid_t));
+
+	learner_receive_accept(l, ack);
+}
+
+/*acceptorackɴ*/
+static void close_instance(struct learner* l, iid_t iid)
+{
+	send_ack(l, 0, iid);
+	send_ack(l, 1, iid);
+}
+
+/*һ᰸źֵ*/
+static void expect_deliver(struct learner* l, iid_t iid)
+{
+	iid_t v;
+	accept_ack* ack = learner_deliver_next(l);
+
+	assert(ack != NULL);
+	assert(ack->iid == iid);
+	memcpy(&v, ack->value, sizeof(iid_t));
+	assert(v == iid);
+	accept_ack_unref(ack);
+}
+
+/*ڴظack*/
+static void test_quorum()
+{
+	struct learner* l = learner_new(ACCEPTORS);
+
+	send_ack(l, 0, 1);
+	send_ack(l, 0, 1);
+	assert(learner_deliver_next(l) == NULL);
+
+	send_ack(l, 2, 1);
+	expect_deliver(l, 1);
+	assert(learner_deliver_next(l) == NULL);
+
+	/*Ѿ᰸ackֱӶ*/
+	close_instance(l, 1);
+	assert(learner_deliver_next(l) == NULL);
+
+	learner_free(l);
+}
+
+/*ͨ᰸iid˳򷢱ĲλԱiid + window*/
+static void test_window_wrap()
+{
+	iid_t iid;
+	struct learner* l = learner_new(ACCEPTORS);
+
+	for(iid = WINDOW; iid >= 2; iid--)
+		close_instance(l, iid);
+	assert(learner_deliver_next(l) == NULL);
+
+	close_instance(l, 1);
+	for(iid = 1; iid <= WINDOW; iid++)
+		expect_deliver(l, iid);
+	assert(learner_deliver_next(l) == NULL);
+
+	/*ƴڼȦÿλ*/
+	for(iid = WINDOW + 1; iid <= 4 * WINDOW; iid++){
+		close_instance(l, iid);
+		expect_deliver(l, iid);
+	}
+
+	learner_free(l);
+}
+
+/*[current_iid, current_iid + window)ackҪΪholeϽ*/
+static void test_out_of_window()
+{
+	iid_t from, to;
+	struct learner* l = learner_new(ACCEPTORS);
+
+	close_instance(l, 1 + WINDOW);
+	assert(learner_deliver_next(l) == NULL);
+
+	assert(learner_has_holes(l, &from, &to));
+	assert(from == 1 && to == 1 + WINDOW);
+
+	/*ǰ֮յackͨ*/
+	for(from = 1; from <= WINDOW; from++){
+		close_instance(l, from);
+		expect_deliver(l, from);
+	}
+	close_instance(l, 1 + WINDOW);
+	expect_deliver(l, 1 + WINDOW);
+	assert(!learner_has_holes(l, &from, &to));
+
+	learner_free(l);
+}
+
+/*Ӧø֪᰸֮ʼ֮ǰʵ*/
+static void test_set_instance_id()
+{
+	struct learner* l = learner_new(ACCEPTORS);
+
+	close_instance(l, 2);
+	learner_set_instance_id(l, 1000);
+	assert(learner_deliver_next(l) == NULL);
+
+	close_instance(l, 1001);
+	expect_deliver(l, 1001);
+
+	learner_free(l);
+}
+
+/*64λɨλͼholeԽֱ߽ʹڻƶҪȷ*/
+static void test_holes()
+{
+	iid_t iid, from, to;
+	struct learner* l = learner_new(ACCEPTORS);
+
+	assert(!learner_has_holes(l, &from, &to));
+
+	close_instance(l, 2);
+	close_instance(l, 3);
+	close_instance(l, 66);
+	for(iid = 100; iid <= 127; iid++)
+		close_instance(l, iid);
+
+	assert(learner_has_holes(l, &from, &to));
+	assert(from == 1 && to == 2);
+	assert(learner_next_hole(l, 2, &from, &to));
+	assert(from == 4 && to == 66);
+	assert(learner_next_hole(l, 67, &from, &to));
+	assert(from == 67 && to == 100);
+	/*highest_iid_closed֮᰸hole*/
+	assert(!learner_next_hole(l, 101, &from, &to));
+
+	/*λͼholecurrent_iidʼ*/
+	close_instance(l, 1);
+	for(iid = 1; iid <= 3; iid++)
+		expect_deliver(l, iid);
+	assert(learner_has_holes(l, &from, &to));
+	assert(from == 4 && to == 66);
+
+	/*[4, 100)󷢱127ٹرջƵλͼͷ᰸*/
+	for(iid = 4; iid < 100; iid++)
+		if(iid != 66)
+			close_instance(l, iid);
+	for(iid = 4; iid <= 127; iid++)
+		expect_deliver(l, iid);
+	assert(!learner_has_holes(l, &from, &to));
+
+	close_instance(l, 130);
+	close_instance(l, 200);
+	assert(learner_has_holes(l, &from, &to));
+	assert(from == 128 && to == 130);
+	assert(learner_next_hole(l, to, &from, &to));
+	assert(from == 131 && to == 200);
+
+	learner_free(l);
+}
+
+/*ָʱcatch_up_iid֮ǰ᰸holeϽ粻*/
+static void test_catch_up_holes()
+{
+	iid_t from, to;
+	struct learner* l = learner_new(ACCEPTORS);
+
+	learner_catch_up(l, 10);
+	assert(learner_has_holes(l, &from, &to));
+	assert(from == 1 && to == 11);
+
+	learner_catch_up(l, 10 * WINDOW);
+	assert(learner_has_holes(l, &from, &to));
+	assert(from == 1 && to == 1 + WINDOW);
+
+	learner_free(l);
+}
+
+/*رռֻʵһͨʱ*/
+static void test_closed_count()
+{
+	struct learner* l = learner_new(ACCEPTORS);
+
+	close_instance(l, 5);
+	send_ack(l, 2, 5);
+	close_instance(l, 6);
+	assert(learner_closed_count(l) == 2);
+
+	learner_free(l);
+}
+
+int main(int argc, char* argv[])
+{
+	paxos_config.learn_instances = WINDOW;
+	paxos_config.learner_catch_up = 1;
+	paxos_config.verbosity = PAXOS_LOG_ERROR;
+
+	test_quorum();
+	test_window_wrap();
+	test_out_of_window();
+	test_set_instance_id();
+	test_holes();
+	test_catch_up_holes();
+	test_closed_count();
+
+	printf("test_learner: ok\n");
+	return 0;
+}
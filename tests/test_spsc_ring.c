@@ -0,0 +1,134 @@
+/*spscζеĵԪԣֱӰʵԱ±赽Ƹ
+  gcc -std=gnu99 -Wall -pthread -I.. -o test_spsc_ring test_spsc_ring.c && ./test_spsc_ring*/
+#include "../spsc_ring.c"
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define THREAD_ITEMS 100000
+
+/*ȡ2*/
+static void test_size()
+{
+	struct spsc_ring* r;
+
+	r = spsc_ring_new(1);
+	assert(spsc_ring_size(r) == 1);
+	spsc_ring_free(r);
+
+	r = spsc_ring_new(1000);
+	assert(spsc_ring_size(r) == 1024);
+	spsc_ring_free(r);
+
+	r = spsc_ring_new(1024);
+	assert(spsc_ring_size(r) == 1024);
+	spsc_ring_free(r);
+}
+
+/*д֮pushʧܣȡ֮popNULL˳򲻱*/
+static void test_full_empty(struct spsc_ring* r)
+{
+	intptr_t i;
+	int size = spsc_ring_size(r);
+
+	assert(spsc_ring_pop(r) == NULL);
+	for(i = 1; i <= size; i++)
+		assert(spsc_ring_push(r, (void*)i) == 0);
+	assert(spsc_ring_count(r) == size);
+	assert(spsc_ring_push(r, (void*)i) == -1);
+
+	for(i = 1; i <= size; i++)
+		assert(spsc_ring_pop(r) == (void*)i);
+	assert(spsc_ring_count(r) == 0);
+	assert(spsc_ring_pop(r) == NULL);
+}
+
+/*±ƣÿηĸʣȦ֮ÿλڲͬƫù*/
+static void test_wraparound()
+{
+	intptr_t i, next = 1, expect = 1;
+	struct spsc_ring* r = spsc_ring_new(8);
+
+	for(i = 0; i < 1000; i++){
+		while(next - expect < 5)
+			assert(spsc_ring_push(r, (void*)next++) == 0);
+		assert(spsc_ring_count(r) == 5);
+		while(next - expect > 2)
+			assert(spsc_ring_pop(r) == (void*)expect++);
+	}
+
+	while(expect < next)
+		assert(spsc_ring_pop(r) == (void*)expect++);
+	test_full_empty(r);
+	spsc_ring_free(r);
+}
+
+/*headtailǲӵunsignedص0countжȻȷ*/
+static void test_counter_overflow()
+{
+	struct spsc_ring* r = spsc_ring_new(8);
+
+	r->head = r->tail = UINT_MAX - 3;
+	test_full_empty(r);
+	assert(r->tail < 8);
+
+	r->head = r->tail = UINT_MAX;
+	test_full_empty(r);
+	spsc_ring_free(r);
+}
+
+/*ߺڲ̣ͬ߳߰˳յÿһԪ*/
+static void* producer(void* arg)
+{
+	intptr_t i;
+	struct spsc_ring* r = arg;
+
+	for(i = 1; i <= THREAD_ITEMS; i++)
+		while(spsc_ring_push(r, (void*)i) != 0)
+			sched_yield();
+
+	return NULL;
+}
+
+static void test_threads()
+{
+	void* p;
+	intptr_t expect = 1;
+	pthread_t t;
+	struct spsc_ring* r = spsc_ring_new(64);
+
+	r->head = r->tail = UINT_MAX - 1000;
+	assert(pthread_create(&t, NULL, producer, r) == 0);
+
+	while(expect <= THREAD_ITEMS){
+		if((p = spsc_ring_pop(r)) != NULL)
+			assert(p == (void*)expect++);
+		else
+			sched_yield();
+	}
+
+	pthread_join(t, NULL);
+	assert(spsc_ring_pop(r) == NULL);
+	spsc_ring_free(r);
+}
+
+int main(int argc, char* argv[])
+{
+	struct spsc_ring* r;
+
+	test_size();
+
+	r = spsc_ring_new(16);
+	test_full_empty(r);
+	test_full_empty(r);
+	spsc_ring_free(r);
+
+	test_wraparound();
+	test_counter_overflow();
+	test_threads();
+
+	printf("test_spsc_ring: ok\n");
+	return 0;
+}
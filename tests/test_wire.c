@@ -0,0 +1,269 @@
+/*ϸʽĵԪ: ϢͷvarintС˲֡ŷķװͽ
+  gcc -std=gnu99 -Wall -I.. -o test_wire test_wire.c ../tcp_sendbuf.c ../tcp_recvbuf.c ../libpaxos_message.c ../paxos.c -levent && ./test_wire*/
+#include "tcp_sendbuf.h"
+#include "tcp_recvbuf.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <event2/buffer.h>
+
+#define MAX_MSGS 8
+
+/*dispatchصյϢϢֻڻصڼЧƳ*/
+struct received
+{
+	int			count;
+	paxos_msg	msgs[MAX_MSGS];
+	char		bodies[MAX_MSGS][64];
+};
+
+static void on_msg(paxos_msg* msg, void* body, void* arg)
+{
+	struct received* r = arg;
+
+	assert(r->count < MAX_MSGS);
+	assert(msg->data_size <= sizeof(r->bodies[0]));
+	r->msgs[r->count] = *msg;
+	memcpy(r->bodies[r->count], body, msg->data_size);
+	r->count++;
+}
+
+/*Ϣͷ: 1ֽͼLEB128ĳȣ볤ֵ*/
+static void test_sub_header()
+{
+	int i, n;
+	paxos_msg msg;
+	unsigned char buf[PAXOS_SUB_HEADER_MAX];
+	uint32_t sizes[] = {0, 1, 127, 128, 16383, 16384, (1 << 21) - 1, 1 << 21, 1 << 28, UINT32_MAX};
+	int lens[] = {2, 2, 2, 3, 3, 4, 4, 5, 6, 6};
+
+	for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+		n = paxos_sub_header_encode(buf, accept_acks, sizes[i]);
+		assert(n == lens[i]);
+
+		memset(&msg, 0, sizeof(msg));
+		assert(paxos_sub_header_decode(buf, n, &msg) == n);
+		assert(msg.version == PAXOS_WIRE_VERSION);
+		assert(msg.type == accept_acks);
+		assert(msg.data_size == sizes[i]);
+
+		/*ͷ*/
+		assert(paxos_sub_header_decode(buf, n - 1, &msg) == 0);
+	}
+
+	/*ֶγ5ֽǸʽ*/
+	memset(buf, 0x80, sizeof(buf));
+	assert(paxos_sub_header_decode(buf, sizeof(buf), &msg) == 0);
+}
+
+/*ֶζǶСˣͱֳ޹*/
+static void test_layout()
+{
+	unsigned char* p;
+	accept_ack aa;
+	struct evbuffer* out = evbuffer_new();
+	unsigned char expect[] = {
+		PAXOS_WIRE_VERSION, accept_acks, 25, 0, 0, 0,	/*paxos_msg*/
+		2, 0, 0, 0,										/*acceptor_id*/
+		0x04, 0x03, 0x02, 0x01,							/*iid*/
+		7, 0, 0, 0,										/*ballot*/
+		5, 0, 0, 0,										/*value_ballot*/
+		1, 0,											/*is_final*/
+		3, 0, 0, 0,										/*value_size*/
+		'a', 'b', 'c'
+	};
+
+	assert(sizeof(paxos_msg) == 6);
+	assert(sizeof(accept_ack) == 22);
+	assert(sizeof(repeat_req) == 8);
+	assert(sizeof(max_iid_ack) == 20);
+	assert(sizeof(chosen_msg) == 8);
+	assert(sizeof(peer_hello) == 12);
+	assert(sizeof(credit_msg) == 12);
+
+	aa.acceptor_id = 2;
+	aa.iid = 0x01020304;
+	aa.ballot = 7;
+	aa.value_ballot = 5;
+	aa.is_final = 1;
+	aa.value_size = 3;
+	sendbuf_encode_msg(out, accept_acks, &aa, sizeof(aa), "abc", 3);
+
+	assert(evbuffer_get_length(out) == sizeof(expect));
+	p = evbuffer_pullup(out, -1);
+	assert(memcmp(p, expect, sizeof(expect)) == 0);
+
+	evbuffer_free(out);
+}
+
+/*Ϣ֡룬ֶκֵ*/
+static void test_msg_roundtrip()
+{
+	accept_ack aa, *got;
+	struct received r;
+	struct evbuffer* out = evbuffer_new();
+
+	aa.acceptor_id = 1;
+	aa.iid = 100000;
+	aa.ballot = 3;
+	aa.value_ballot = 3;
+	aa.is_final = 0;
+	aa.value_size = 5;
+	sendbuf_encode_msg(out, accept_acks, &aa, sizeof(aa), "hello", 5);
+
+	memset(&r, 0, sizeof(r));
+	assert(recvbuf_dispatch(out, on_msg, &r) == 1);
+	assert(evbuffer_get_length(out) == 0);
+
+	assert(r.count == 1);
+	assert(r.msgs[0].type == accept_acks);
+	assert(r.msgs[0].data_size == sizeof(aa) + 5);
+	got = (accept_ack*)r.bodies[0];
+	assert(got->acceptor_id == 1 && got->iid == 100000 && got->ballot == 3);
+	assert(got->value_size == 5 && memcmp(got->value, "hello", 5) == 0);
+
+	evbuffer_free(out);
+}
+
+/*Ϣһŷ⣬˳ֻһϢʱԭͨ֡*/
+static void test_batch_roundtrip()
+{
+	unsigned char* p;
+	repeat_req rr = {10, 20};
+	chosen_msg cm = {11, 4};
+	credit_msg cr = {2, 64, 1 << 20};
+	struct received r;
+	struct evbuffer* batch = evbuffer_new();
+	struct evbuffer* out = evbuffer_new();
+
+	sendbuf_encode_sub(batch, repeat_reqs, &rr, sizeof(rr), NULL, 0);
+	sendbuf_encode_sub(batch, chosen_msgs, &cm, sizeof(cm), NULL, 0);
+	sendbuf_encode_sub(batch, credit_msgs, &cr, sizeof(cr), NULL, 0);
+	sendbuf_seal(batch, 3, out);
+	assert(evbuffer_get_length(batch) == 0);
+
+	p = evbuffer_pullup(out, sizeof(paxos_msg));
+	assert(p[0] == PAXOS_WIRE_VERSION && p[1] == batch_msgs);
+	assert(evbuffer_get_length(out) == sizeof(paxos_msg) + 3 * 2 + sizeof(rr) + sizeof(cm) + sizeof(cr));
+
+	/*ŷ֮һֻһϢ֡*/
+	sendbuf_encode_sub(batch, chosen_msgs, &cm, sizeof(cm), NULL, 0);
+	sendbuf_seal(batch, 1, out);
+
+	memset(&r, 0, sizeof(r));
+	assert(recvbuf_dispatch(out, on_msg, &r) == 4);
+	assert(evbuffer_get_length(out) == 0);
+
+	assert(r.msgs[0].type == repeat_reqs && memcmp(r.bodies[0], &rr, sizeof(rr)) == 0);
+	assert(r.msgs[1].type == chosen_msgs && memcmp(r.bodies[1], &cm, sizeof(cm)) == 0);
+	assert(r.msgs[2].type == credit_msgs && memcmp(r.bodies[2], &cr, sizeof(cr)) == 0);
+	assert(r.msgs[3].type == chosen_msgs && r.msgs[3].data_size == sizeof(cm));
+	assert(memcmp(r.bodies[3], &cm, sizeof(cm)) == 0);
+
+	/*countΪ0ʱʲôд*/
+	sendbuf_seal(batch, 0, out);
+	assert(evbuffer_get_length(out) == 0);
+
+	evbuffer_free(batch);
+	evbuffer_free(out);
+}
+
+/*֡ڻȺֽڵٴ*/
+static void test_partial()
+{
+	size_t len;
+	unsigned char frame[64];
+	chosen_msg cm = {5, 1};
+	struct received r;
+	struct evbuffer* out = evbuffer_new();
+	struct evbuffer* in = evbuffer_new();
+
+	sendbuf_encode_msg(out, chosen_msgs, &cm, sizeof(cm), NULL, 0);
+	len = evbuffer_remove(out, frame, sizeof(frame));
+
+	memset(&r, 0, sizeof(r));
+	evbuffer_add(in, frame, 3);
+	assert(recvbuf_dispatch(in, on_msg, &r) == 0);
+	evbuffer_add(in, frame + 3, len - 4);
+	assert(recvbuf_dispatch(in, on_msg, &r) == 0);
+	assert(evbuffer_get_length(in) == len - 1);
+
+	evbuffer_add(in, frame + len - 1, 1);
+	assert(recvbuf_dispatch(in, on_msg, &r) == 1);
+	assert(r.count == 1 && memcmp(r.bodies[0], &cm, sizeof(cm)) == 0);
+
+	evbuffer_free(in);
+	evbuffer_free(out);
+}
+
+/*֡ͷpeer_helloеİ汾ͬ-1Ϣڻ*/
+static void test_version_mismatch()
+{
+	unsigned char* p;
+	chosen_msg cm = {5, 1};
+	peer_hello h = {PAXOS_WIRE_VERSION + 1, role_learner, 0};
+	struct received r;
+	struct evbuffer* out = evbuffer_new();
+
+	sendbuf_encode_msg(out, chosen_msgs, &cm, sizeof(cm), NULL, 0);
+	p = evbuffer_pullup(out, -1);
+	p[0] = PAXOS_WIRE_VERSION - 1;
+
+	memset(&r, 0, sizeof(r));
+	assert(recvbuf_dispatch(out, on_msg, &r) == -1);
+	assert(r.count == 0);
+	assert(evbuffer_get_length(out) == sizeof(paxos_msg) + sizeof(cm));
+	evbuffer_drain(out, evbuffer_get_length(out));
+
+	sendbuf_encode_msg(out, peer_hellos, &h, sizeof(h), NULL, 0);
+	assert(recvbuf_dispatch(out, on_msg, &r) == -1);
+	assert(r.count == 0);
+
+	evbuffer_free(out);
+}
+
+/*ϢԽŷı߽Ƕŷ⣬ŷⶪ֡ճ*/
+static void test_malformed_batch()
+{
+	unsigned char sub[PAXOS_SUB_HEADER_MAX];
+	paxos_msg h;
+	chosen_msg cm = {5, 1};
+	struct received r;
+	struct evbuffer* out = evbuffer_new();
+
+	h.version = PAXOS_WIRE_VERSION;
+	h.type = batch_msgs;
+	h.data_size = htole32(paxos_sub_header_encode(sub, chosen_msgs, sizeof(cm) + 1) + sizeof(cm));
+	evbuffer_add(out, &h, sizeof(h));
+	evbuffer_add(out, sub, le32toh(h.data_size) - sizeof(cm));
+	evbuffer_add(out, &cm, sizeof(cm));
+
+	h.data_size = htole32(paxos_sub_header_encode(sub, batch_msgs, 0));
+	evbuffer_add(out, &h, sizeof(h));
+	evbuffer_add(out, sub, le32toh(h.data_size));
+
+	sendbuf_encode_msg(out, chosen_msgs, &cm, sizeof(cm), NULL, 0);
+
+	memset(&r, 0, sizeof(r));
+	assert(recvbuf_dispatch(out, on_msg, &r) == 1);
+	assert(r.count == 1 && r.msgs[0].type == chosen_msgs);
+	assert(evbuffer_get_length(out) == 0);
+
+	evbuffer_free(out);
+}
+
+int main(int argc, char* argv[])
+{
+	paxos_config.verbosity = PAXOS_LOG_QUIET;
+
+	test_sub_header();
+	test_layout();
+	test_msg_roundtrip();
+	test_batch_roundtrip();
+	test_partial();
+	test_version_mismatch();
+	test_malformed_batch();
+
+	printf("test_wire: ok\n");
+	return 0;
+}
@@ -0,0 +1,389 @@
+#define _GNU_SOURCE /*struct ucred*/
+#include "transport.h"
+#include "paxos.h"
+#include "uring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <event2/buffer.h>
+
+/*ÿĻλС2*/
+#define SHM_RING_SIZE	(1 << 20)
+#define SHM_CACHE_LINE	64
+
+/*ߵߵֽڻhead/tailֻ&ȡ±*/
+struct shm_ring
+{
+	uint32_t	head;			/*ֻ޸*/
+	char		pad1[SHM_CACHE_LINE - sizeof(uint32_t)];
+	uint32_t	tail;			/*ֻ޸*/
+	char		pad2[SHM_CACHE_LINE - sizeof(uint32_t)];
+	int32_t		reader_waiting;	/*߶պ1д0ͨӷһֽڻ*/
+	int32_t		writer_waiting;	/*д1ȡߺ0*/
+	char		pad3[SHM_CACHE_LINE - 2 * sizeof(int32_t)];
+	char		data[SHM_RING_SIZE];
+};
+
+struct shm_segment
+{
+	struct shm_ring	ring[2];	/*ring[0]: ӷ->ring[1]: ->ӷ*/
+};
+
+/*һshmӣfilter buffereventcontext*/
+struct shm_conn
+{
+	struct shm_segment*	seg;		/*յǰNULL*/
+	struct shm_ring*	out;
+	struct shm_ring*	in;
+	int					connector;	/*ӷ𴴽ɾڴ*/
+	char				name[64];	/*ڴε֣ӷڿȷ(0β)Ϊ*/
+	struct bufferevent*	bev;		/*filter*/
+	struct event*		kick_ev;	/*λпռˣдfilterʣµ*/
+	int					blocked;
+};
+
+static unsigned shm_seq = 0;
+
+static void set_unix_addr(struct transport_addr* ta, const char* path, int abstract)
+{
+	struct sockaddr_un* sun = (struct sockaddr_un *)&ta->sa;
+	size_t n = strlen(path);
+
+	memset(sun, 0, sizeof(struct sockaddr_un));
+	sun->sun_family = AF_UNIX;
+	/*ռ0ͷļϵͳsocketļ*/
+	memcpy(sun->sun_path + abstract, path, n);
+	ta->len = offsetof(struct sockaddr_un, sun_path) + abstract + n + (abstract ? 0 : 1);
+}
+
+int transport_addr_parse(const char* addr, int port, int listen, struct transport_addr* ta)
+{
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	struct sockaddr_in* sin = (struct sockaddr_in *)&ta->sa;
+
+	memset(ta, 0, sizeof(struct transport_addr));
+
+	if(strncmp(addr, "unix:", 5) == 0){
+		if(strlen(addr + 5) == 0 || strlen(addr + 5) >= sizeof(path))
+			return -1;
+		ta->type = transport_unix;
+		set_unix_addr(ta, addr + 5, 0);
+	}
+	else if(strncmp(addr, "shm:", 4) == 0){
+		if(strlen(addr + 4) == 0 || snprintf(path, sizeof(path) - 1, "libpaxos-shm-%s", addr + 4) >= (int)sizeof(path) - 1)
+			return -1;
+		ta->type = transport_shm;
+		set_unix_addr(ta, path, 1);
+	}
+	else{
+		ta->type = transport_tcp;
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(port);
+		sin->sin_addr.s_addr = listen ? htonl(0) : inet_addr(addr);
+		ta->len = sizeof(struct sockaddr_in);
+		snprintf(ta->desc, sizeof(ta->desc), "%s:%d", listen ? "0.0.0.0" : addr, port);
+		return 0;
+	}
+
+	snprintf(ta->desc, sizeof(ta->desc), "%s", addr);
+	return 0;
+}
+
+static size_t shm_ring_count(struct shm_ring* r)
+{
+	return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+}
+
+/*srcܷµƵ*/
+static size_t shm_ring_write(struct shm_ring* r, struct evbuffer* src)
+{
+	uint32_t tail = r->tail;
+	size_t space = SHM_RING_SIZE - (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE));
+	size_t n = evbuffer_get_length(src);
+	size_t off = tail & (SHM_RING_SIZE - 1);
+	size_t first;
+
+	if(n > space)
+		n = space;
+	first = n < SHM_RING_SIZE - off ? n : SHM_RING_SIZE - off;
+
+	evbuffer_remove(src, r->data + off, first);
+	if(n > first)
+		evbuffer_remove(src, r->data, n - first);
+
+	/*Ͷȡreader_waiting֮Ҫȫ򣬷˫*/
+	__atomic_store_n(&r->tail, tail + n, __ATOMIC_SEQ_CST);
+	return n;
+}
+
+/*ѻȫƵdst*/
+static size_t shm_ring_read(struct shm_ring* r, struct evbuffer* dst)
+{
+	uint32_t head = r->head;
+	size_t n = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - head;
+	size_t off = head & (SHM_RING_SIZE - 1);
+	size_t first = n < SHM_RING_SIZE - off ? n : SHM_RING_SIZE - off;
+
+	evbuffer_add(dst, r->data + off, first);
+	if(n > first)
+		evbuffer_add(dst, r->data, n - first);
+
+	__atomic_store_n(&r->head, head + n, __ATOMIC_SEQ_CST);
+	return n;
+}
+
+/*Զڵȴʱ־ɵ߷һֽڣͬһεȴֻһ*/
+static int shm_wake(int32_t* waiting)
+{
+	int32_t expected = 1;
+	return __atomic_compare_exchange_n(waiting, &expected, 0, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static int shm_map(struct shm_conn* c, int flags)
+{
+	void* p;
+	int fd = shm_open(c->name, flags, 0600);
+	if(fd < 0)
+		return -1;
+
+	if((flags & O_CREAT) && ftruncate(fd, sizeof(struct shm_segment)) != 0){
+		close(fd);
+		return -1;
+	}
+
+	p = mmap(NULL, sizeof(struct shm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED)
+		return -1;
+
+	c->seg = (struct shm_segment *)p;
+	c->out = &c->seg->ring[c->connector ? 0 : 1];
+	c->in = &c->seg->ring[c->connector ? 1 : 0];
+	return 0;
+}
+
+/*filter: ϲдݷŽڴ棬ֻлֽ*/
+static enum bufferevent_filter_result shm_output(struct evbuffer* src, struct evbuffer* dst, ev_ssize_t limit, 
+	enum bufferevent_flush_mode mode, void* ctx)
+{
+	struct shm_conn* c = (struct shm_conn *)ctx;
+
+	/*ӽ֮ǰд*/
+	if(c->seg == NULL)
+		return BEV_NEED_MORE;
+
+	if(shm_ring_write(c->out, src) > 0 && shm_wake(&c->out->reader_waiting))
+		evbuffer_add(dst, "w", 1);
+
+	if(evbuffer_get_length(src) > 0){
+		/*ˣȶԶȡݺѡñ־ǰԶ˿Ѿȡˣټһ*/
+		c->blocked = 1;
+		__atomic_store_n(&c->out->writer_waiting, 1, __ATOMIC_SEQ_CST);
+		if(shm_ring_count(c->out) < SHM_RING_SIZE)
+			event_active(c->kick_ev, EV_WRITE, 0);
+		return BEV_NEED_MORE;
+	}
+
+	c->blocked = 0;
+	return BEV_OK;
+}
+
+/*ֻshm_newɵ"/libpaxos-<pid>-<seq>"pidǿӶԶ˵Ḷ̌
+  Զ˲ü򿪻ɾĹڴ*/
+static int shm_valid_name(struct shm_conn* c)
+{
+	int pid, n = 0;
+	unsigned seq;
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	const char* prefix = "/libpaxos-";
+	size_t plen = strlen(prefix);
+
+	if(strncmp(c->name, prefix, plen) != 0 || strspn(c->name + plen, "0123456789-") != strlen(c->name + plen))
+		return 0;
+	if(sscanf(c->name + plen, "%d-%u%n", &pid, &seq, &n) != 2 || c->name[plen + n] != '\0')
+		return 0;
+
+	if(getsockopt(bufferevent_getfd(bufferevent_get_underlying(c->bev)), SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return 0;
+	return cred.pid == pid;
+}
+
+/*filter: յֽںӹڴȡ*/
+static enum bufferevent_filter_result shm_input(struct evbuffer* src, struct evbuffer* dst, ev_ssize_t limit, 
+	enum bufferevent_flush_mode mode, void* ctx)
+{
+	struct shm_conn* c = (struct shm_conn *)ctx;
+
+	/*һյӷĹڴ*/
+	if(c->seg == NULL){
+		struct evbuffer_ptr end = evbuffer_search(src, "", 1, NULL);
+		if(end.pos < 0)
+			return evbuffer_get_length(src) < sizeof(c->name) ? BEV_NEED_MORE : BEV_ERROR;
+		if(end.pos >= (ev_ssize_t)sizeof(c->name))
+			return BEV_ERROR;
+
+		evbuffer_remove(src, c->name, end.pos + 1);
+		if(!shm_valid_name(c)){
+			paxos_log_error("Rejected shared memory name from peer");
+			c->name[0] = '\0';
+			return BEV_ERROR;
+		}
+		if(shm_map(c, O_RDWR) != 0){
+			paxos_log_error("Failed to map shared memory %s: %s", c->name, strerror(errno));
+			return BEV_ERROR;
+		}
+		/*˫Ѿӳ䣬ֲҪ*/
+		shm_unlink(c->name);
+		event_active(c->kick_ev, EV_WRITE, 0);
+	}
+
+	evbuffer_drain(src, evbuffer_get_length(src));
+
+	for(;;){
+		if(shm_ring_read(c->in, dst) > 0 && shm_wake(&c->in->writer_waiting))
+			bufferevent_write(bufferevent_get_underlying(c->bev), "w", 1);
+
+		/*õȴ־ݣ˵Զ֮ǰд룬ûзֽ*/
+		__atomic_store_n(&c->in->reader_waiting, 1, __ATOMIC_SEQ_CST);
+		if(shm_ring_count(c->in) == 0)
+			break;
+		__atomic_store_n(&c->in->reader_waiting, 0, __ATOMIC_SEQ_CST);
+	}
+
+	/*ֽҲܱʾԶȡݣ֮ǰдµļд*/
+	if(c->blocked)
+		event_active(c->kick_ev, EV_WRITE, 0);
+
+	return BEV_OK;
+}
+
+static void shm_kick(evutil_socket_t fd, short event, void* arg)
+{
+	struct shm_conn* c = (struct shm_conn *)arg;
+	bufferevent_flush(c->bev, EV_WRITE, BEV_NORMAL);
+}
+
+static void shm_conn_free(void* ctx)
+{
+	struct shm_conn* c = (struct shm_conn *)ctx;
+
+	if(c->seg != NULL)
+		munmap(c->seg, sizeof(struct shm_segment));
+	/*Զ˻ûӳʱӷɾ*/
+	if(c->connector && c->name[0] != '\0')
+		shm_unlink(c->name);
+
+	event_free(c->kick_ev);
+	free(c);
+}
+
+static struct shm_conn* shm_wrap(struct event_base* b, struct bufferevent* underlying, int connector, int options)
+{
+	struct shm_conn* c = (struct shm_conn *)calloc(1, sizeof(struct shm_conn));
+
+	c->connector = connector;
+	c->kick_ev = event_new(b, -1, 0, shm_kick, c);
+	/*CLOSE_ON_FREEʱͷfilterһͷſ*/
+	c->bev = bufferevent_filter_new(underlying, shm_input, shm_output, options, shm_conn_free, c);
+	if(c->bev == NULL){
+		bufferevent_free(underlying);
+		event_free(c->kick_ev);
+		free(c);
+		return NULL;
+	}
+
+	return c;
+}
+
+/*ӷڴΣΪдӣӽ󷢳*/
+static struct bufferevent* shm_new(struct event_base* b, struct bufferevent* underlying, int options)
+{
+	struct shm_conn* c = shm_wrap(b, underlying, 1, options);
+	if(c == NULL)
+		return NULL;
+
+	snprintf(c->name, sizeof(c->name), "/libpaxos-%d-%u", (int)getpid(), __atomic_fetch_add(&shm_seq, 1, __ATOMIC_RELAXED));
+	if(shm_map(c, O_RDWR | O_CREAT | O_EXCL) != 0){
+		paxos_log_error("Failed to create shared memory %s: %s", c->name, strerror(errno));
+		c->name[0] = '\0';
+		bufferevent_free(c->bev);
+		return NULL;
+	}
+
+	/*򶼴Ӷտʼһдʱ*/
+	memset(c->seg, 0, sizeof(struct shm_segment));
+	c->seg->ring[0].reader_waiting = 1;
+	c->seg->ring[1].reader_waiting = 1;
+
+	bufferevent_write(underlying, c->name, strlen(c->name) + 1);
+	return c->bev;
+}
+
+/*filter: underlyingĻصȥfilterfilterʱֻunderlying
+  underlyingĻصڲԼʱã̻߳*/
+static int shm_underlying_options(struct transport_addr* ta, int options)
+{
+	if(ta->type == transport_shm && (options & BEV_OPT_THREADSAFE))
+		options |= BEV_OPT_DEFER_CALLBACKS | BEV_OPT_UNLOCK_CALLBACKS;
+	return options;
+}
+
+/*ڴӵݱͲsocketʹio_uring*/
+static int use_uring(struct transport_addr* ta)
+{
+	return paxos_config.io_uring && ta->type != transport_shm;
+}
+
+struct bufferevent* transport_new(struct event_base* b, struct transport_addr* ta, int options)
+{
+	struct bufferevent* bev;
+
+	if(use_uring(ta) && (bev = uring_new(b, options)) != NULL)
+		return bev;
+
+	bev = bufferevent_socket_new(b, -1, shm_underlying_options(ta, options));
+
+	if(ta->type == transport_shm && bev != NULL)
+		bev = shm_new(b, bev, options);
+
+	return bev;
+}
+
+int transport_connect(struct bufferevent* bev, struct transport_addr* ta)
+{
+	if(ta->type == transport_shm)
+		bev = bufferevent_get_underlying(bev);
+	else if(uring_owns(bev))
+		return uring_connect(bev, (struct sockaddr *)&ta->sa, ta->len);
+
+	return bufferevent_socket_connect(bev, (struct sockaddr *)&ta->sa, ta->len);
+}
+
+struct bufferevent* transport_accept(struct event_base* b, struct transport_addr* ta, evutil_socket_t fd, int options)
+{
+	struct shm_conn* c;
+	struct bufferevent* bev;
+
+	if(use_uring(ta) && (bev = uring_accept(b, fd, options)) != NULL)
+		return bev;
+
+	bev = bufferevent_socket_new(b, fd, shm_underlying_options(ta, options));
+
+	if(ta->type == transport_shm && bev != NULL){
+		c = shm_wrap(b, bev, 0, options);
+		return c != NULL ? c->bev : NULL;
+	}
+
+	return bev;
+}
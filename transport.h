@@ -0,0 +1,38 @@
+#ifndef __PAXOS_TRANSPORT_H
+#define __PAXOS_TRANSPORT_H
+
+#include <sys/socket.h>
+#include <event2/event.h>
+#include <event2/bufferevent.h>
+
+/*ӵĴ䷽ʽļаַѡ:
+  host port	TCP
+  unix:path	AF_UNIXʽsocket
+  shm:name	ڴ滷λֻͬһ̨ϵḶ̌ǳռAF_UNIX socket*/
+enum transport_type
+{
+	transport_tcp,
+	transport_unix,
+	transport_shm,
+};
+
+struct transport_addr
+{
+	int						type;
+	struct sockaddr_storage	sa;			/*connect/bindõĵַ*/
+	socklen_t				len;
+	char					desc[128];	/*־*/
+};
+
+/*еĵַlistenΪ1ʱTCPַ󶨵(ֻö˿)ɹ0*/
+int					transport_addr_parse(const char* addr, int port, int listen, struct transport_addr* ta);
+
+/*ϲֻͨbuffereventshmڿϰһfilterд߹ڴ*/
+/*һδӵbufferevent*/
+struct bufferevent*	transport_new(struct event_base* b, struct transport_addr* ta, int options);
+/*ӣͨBEV_EVENT_CONNECTED/BEV_EVENT_ERROR֪ͨ*/
+int					transport_connect(struct bufferevent* bev, struct transport_addr* ta);
+/*װlistenerܵ*/
+struct bufferevent*	transport_accept(struct event_base* b, struct transport_addr* ta, evutil_socket_t fd, int options);
+
+#endif
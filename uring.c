@@ -0,0 +1,767 @@
+#include "uring.h"
+#include "paxos.h"
+
+#ifdef PAXOS_HAVE_IO_URING
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <event2/buffer.h>
+
+#define URING_ENTRIES		256
+#define URING_CQ_ENTRIES	4096
+#define URING_BUF_COUNT		256			/*ںṩĽջ2*/
+#define URING_BUF_SIZE		(16 * 1024)
+#define URING_BGID			1
+#define URING_SEND_MAX		(256 * 1024)	/*һ;ķֽbufferevent*/
+#define URING_SEND_IOV		64
+#define URING_RESUME_CHECK	1000		/*ͣȡӶüһ(΢)*/
+#define URING_MAGIC			0x75726e67
+
+/*user_dataĵλǲͣλָ*/
+enum
+{
+	op_recv		= 1,
+	op_send		= 2,
+	op_connect	= 3,
+	op_mask		= 3,
+};
+
+struct uring_engine;
+
+struct uring_conn
+{
+	int						magic;
+	struct uring_engine*	e;
+	struct bufferevent*		bev;		/*filterϲʹõbufferevent*/
+	struct bufferevent*		partner;	/*filterpairһˣصָconnbevһconn*/
+	int						fd;
+	int						connected;
+	int						recv_armed;	/*multishotջڽ*/
+	int						sending;
+	int						connecting;
+	int						eof;		/*EOF߳ٽ*/
+	int						read_paused;/*ϲر˶ͣ*/
+	int						closed;		/*ϲѾͷbev;Ĳɺͷ*/
+	int						cancelled;
+	struct evbuffer*		sendq;		/*;ķݣǰ޸*/
+	struct iovec			iov[URING_SEND_IOV];
+	struct msghdr			msg;
+	struct sockaddr_storage	addr;
+	socklen_t				addrlen;
+	struct uring_conn*		prev;
+	struct uring_conn*		next;
+};
+
+/*ÿevent_baseһio_uring*/
+struct uring_engine
+{
+	struct event_base*		base;
+	int						fd;
+	unsigned*				sq_head;
+	unsigned*				sq_tail;
+	unsigned*				sq_mask;
+	unsigned*				sq_entries;
+	unsigned*				sq_flags;
+	unsigned*				sq_array;
+	unsigned				sq_local;	/*Ѿûûзtail*/
+	struct io_uring_sqe*	sqes;
+	unsigned*				cq_head;
+	unsigned*				cq_tail;
+	unsigned*				cq_mask;
+	struct io_uring_cqe*	cqes;
+	void*					sq_ring;
+	size_t					sq_ring_size;
+	void*					cq_ring;
+	size_t					cq_ring_size;
+	size_t					sqes_size;
+	struct io_uring_buf_ring*	br;
+	size_t					br_size;
+	char*					bufs;
+	int						efd;		/*¼ʱں֪ͨeventfd*/
+	struct event*			cq_ev;
+	struct event*			flush_ev;	/*һ¼ѭǰύӵķ*/
+	struct event*			resume_ev;
+	struct uring_conn*		conns;
+	struct uring_engine*	next;
+};
+
+static pthread_mutex_t engines_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct uring_engine* engines = NULL;
+static int uring_disabled = 0;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_on_cq(evutil_socket_t fd, short event, void* arg);
+static void uring_on_flush(evutil_socket_t fd, short event, void* arg);
+static void uring_on_resume(evutil_socket_t fd, short event, void* arg);
+
+static void engine_unmap(struct uring_engine* e)
+{
+	if(e->sqes != NULL && e->sqes != MAP_FAILED)
+		munmap(e->sqes, e->sqes_size);
+	if(e->cq_ring != NULL && e->cq_ring != MAP_FAILED && e->cq_ring != e->sq_ring)
+		munmap(e->cq_ring, e->cq_ring_size);
+	if(e->sq_ring != NULL && e->sq_ring != MAP_FAILED)
+		munmap(e->sq_ring, e->sq_ring_size);
+	if(e->br != NULL && e->br != MAP_FAILED)
+		munmap(e->br, e->br_size);
+	free(e->bufs);
+	if(e->efd >= 0)
+		close(e->efd);
+	if(e->fd >= 0)
+		close(e->fd);
+}
+
+static struct uring_engine* engine_new(struct event_base* b)
+{
+	int i;
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	struct uring_engine* e = (struct uring_engine *)calloc(1, sizeof(struct uring_engine));
+
+	e->base = b;
+	e->efd = -1;
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = URING_CQ_ENTRIES;
+	e->fd = sys_io_uring_setup(URING_ENTRIES, &p);
+	if(e->fd < 0)
+		goto fail;
+
+	e->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	e->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP){
+		if(e->cq_ring_size > e->sq_ring_size)
+			e->sq_ring_size = e->cq_ring_size;
+		e->cq_ring_size = e->sq_ring_size;
+	}
+
+	e->sq_ring = mmap(NULL, e->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->fd, IORING_OFF_SQ_RING);
+	if(e->sq_ring == MAP_FAILED)
+		goto fail;
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+		e->cq_ring = e->sq_ring;
+	else{
+		e->cq_ring = mmap(NULL, e->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->fd, IORING_OFF_CQ_RING);
+		if(e->cq_ring == MAP_FAILED)
+			goto fail;
+	}
+	e->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	e->sqes = mmap(NULL, e->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->fd, IORING_OFF_SQES);
+	if(e->sqes == MAP_FAILED)
+		goto fail;
+
+	e->sq_head = (unsigned *)((char *)e->sq_ring + p.sq_off.head);
+	e->sq_tail = (unsigned *)((char *)e->sq_ring + p.sq_off.tail);
+	e->sq_mask = (unsigned *)((char *)e->sq_ring + p.sq_off.ring_mask);
+	e->sq_entries = (unsigned *)((char *)e->sq_ring + p.sq_off.ring_entries);
+	e->sq_flags = (unsigned *)((char *)e->sq_ring + p.sq_off.flags);
+	e->sq_array = (unsigned *)((char *)e->sq_ring + p.sq_off.array);
+	e->sq_local = *e->sq_tail;
+	e->cq_head = (unsigned *)((char *)e->cq_ring + p.cq_off.head);
+	e->cq_tail = (unsigned *)((char *)e->cq_ring + p.cq_off.tail);
+	e->cq_mask = (unsigned *)((char *)e->cq_ring + p.cq_off.ring_mask);
+	e->cqes = (struct io_uring_cqe *)((char *)e->cq_ring + p.cq_off.cqes);
+
+	/*ջҪ5.19ϵں*/
+	e->br_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+	e->br = mmap(NULL, e->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(e->br == MAP_FAILED)
+		goto fail;
+	e->bufs = (char *)malloc((size_t)URING_BUF_COUNT * URING_BUF_SIZE);
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)e->br;
+	reg.ring_entries = URING_BUF_COUNT;
+	reg.bgid = URING_BGID;
+	if(sys_io_uring_register(e->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+		goto fail;
+
+	for(i = 0; i < URING_BUF_COUNT; i++){
+		e->br->bufs[i].addr = (uint64_t)(uintptr_t)(e->bufs + (size_t)i * URING_BUF_SIZE);
+		e->br->bufs[i].len = URING_BUF_SIZE;
+		e->br->bufs[i].bid = i;
+	}
+	__atomic_store_n(&e->br->tail, URING_BUF_COUNT, __ATOMIC_RELEASE);
+
+	e->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(e->efd < 0 || sys_io_uring_register(e->fd, IORING_REGISTER_EVENTFD, &e->efd, 1) != 0)
+		goto fail;
+
+	e->cq_ev = event_new(b, e->efd, EV_READ | EV_PERSIST, uring_on_cq, e);
+	e->flush_ev = event_new(b, -1, 0, uring_on_flush, e);
+	e->resume_ev = evtimer_new(b, uring_on_resume, e);
+	event_add(e->cq_ev, NULL);
+
+	return e;
+
+fail:
+	paxos_log_error("io_uring unavailable (%s), falling back to libevent sockets", strerror(errno));
+	engine_unmap(e);
+	free(e);
+	return NULL;
+}
+
+/*ÿevent_baseһengine̸߳Դһδʧܺٳ*/
+static struct uring_engine* engine_get(struct event_base* b)
+{
+	struct uring_engine* e;
+
+	pthread_mutex_lock(&engines_mutex);
+	for(e = engines; e != NULL; e = e->next){
+		if(e->base == b)
+			break;
+	}
+	if(e == NULL && !uring_disabled){
+		e = engine_new(b);
+		if(e != NULL){
+			e->next = engines;
+			engines = e;
+		}
+		else
+			uring_disabled = 1;
+	}
+	pthread_mutex_unlock(&engines_mutex);
+
+	return e;
+}
+
+static void uring_submit(struct uring_engine* e)
+{
+	int ret;
+	unsigned pending = e->sq_local - *e->sq_tail;
+
+	__atomic_store_n(e->sq_tail, e->sq_local, __ATOMIC_RELEASE);
+	pending = e->sq_local - __atomic_load_n(e->sq_head, __ATOMIC_ACQUIRE);
+	if(pending == 0)
+		return;
+
+	ret = sys_io_uring_enter(e->fd, pending, 0, 0);
+	if(ret < 0 && errno != EAGAIN && errno != EBUSY && errno != EINTR)
+		paxos_log_error("io_uring_enter failed: %s", strerror(errno));
+}
+
+static struct io_uring_sqe* uring_get_sqe(struct uring_engine* e)
+{
+	unsigned idx;
+	struct io_uring_sqe* sqe;
+
+	/*ύύһ*/
+	if(e->sq_local - __atomic_load_n(e->sq_head, __ATOMIC_ACQUIRE) >= *e->sq_entries){
+		uring_submit(e);
+		if(e->sq_local - __atomic_load_n(e->sq_head, __ATOMIC_ACQUIRE) >= *e->sq_entries)
+			return NULL;
+	}
+
+	idx = e->sq_local & *e->sq_mask;
+	sqe = &e->sqes[idx];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	e->sq_array[idx] = idx;
+	e->sq_local++;
+
+	return sqe;
+}
+
+static void uring_recycle_buffer(struct uring_engine* e, unsigned bid)
+{
+	unsigned short tail = e->br->tail;
+	struct io_uring_buf* buf = &e->br->bufs[tail & (URING_BUF_COUNT - 1)];
+
+	buf->addr = (uint64_t)(uintptr_t)(e->bufs + (size_t)bid * URING_BUF_SIZE);
+	buf->len = URING_BUF_SIZE;
+	buf->bid = bid;
+	__atomic_store_n(&e->br->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void conn_arm_recv(struct uring_conn* c)
+{
+	struct io_uring_sqe* sqe = uring_get_sqe(c->e);
+	if(sqe == NULL)
+		return;
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = c->fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->user_data = (uint64_t)(uintptr_t)c | op_recv;
+	c->recv_armed = 1;
+}
+
+/*;ݷ֮ǰٷ֤˳һsendmsgURING_SEND_IOV*/
+static void conn_start_send(struct uring_conn* c)
+{
+	int n;
+	struct io_uring_sqe* sqe;
+
+	if(evbuffer_get_length(c->sendq) == 0)
+		evbuffer_remove_buffer(bufferevent_get_output(c->bev), c->sendq, URING_SEND_MAX);
+	if(evbuffer_get_length(c->sendq) == 0)
+		return;
+
+	sqe = uring_get_sqe(c->e);
+	if(sqe == NULL)
+		return;
+
+	n = evbuffer_peek(c->sendq, -1, NULL, c->iov, URING_SEND_IOV);
+	memset(&c->msg, 0, sizeof(c->msg));
+	c->msg.msg_iov = c->iov;
+	c->msg.msg_iovlen = n < URING_SEND_IOV ? n : URING_SEND_IOV;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = c->fd;
+	sqe->addr = (uint64_t)(uintptr_t)&c->msg;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = (uint64_t)(uintptr_t)c | op_send;
+	c->sending = 1;
+}
+
+static void conn_free(struct uring_conn* c)
+{
+	struct uring_engine* e = c->e;
+
+	if(c->prev != NULL)
+		c->prev->next = c->next;
+	else
+		e->conns = c->next;
+	if(c->next != NULL)
+		c->next->prev = c->prev;
+
+	if(c->fd >= 0)
+		close(c->fd);
+	evbuffer_free(c->sendq);
+	bufferevent_free(c->partner);
+	c->magic = 0;
+	free(c);
+}
+
+/*ϲͷbev: ȡգshutdown;ķ;ȫɺͷ*/
+static int conn_reap(struct uring_conn* c)
+{
+	struct io_uring_sqe* sqe;
+
+	if(!c->cancelled){
+		c->cancelled = 1;
+		if(c->fd >= 0)
+			shutdown(c->fd, SHUT_RDWR);
+		if(c->recv_armed && (sqe = uring_get_sqe(c->e)) != NULL){
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = (uint64_t)(uintptr_t)c | op_recv;
+			sqe->user_data = 0;
+		}
+	}
+
+	if(c->recv_armed || c->sending || c->connecting)
+		return 0;
+
+	conn_free(c);
+	return 1;
+}
+
+static void uring_flush(struct uring_engine* e)
+{
+	struct uring_conn* c;
+	struct uring_conn* next;
+
+	for(c = e->conns; c != NULL; c = next){
+		next = c->next;
+		if(__atomic_load_n(&c->closed, __ATOMIC_ACQUIRE)){
+			conn_reap(c);
+			continue;
+		}
+		if(!c->connected)
+			continue;
+		if(!c->recv_armed && !c->eof && !c->read_paused)
+			conn_arm_recv(c);
+		if(!c->sending && !c->eof)
+			conn_start_send(c);
+	}
+
+	uring_submit(e);
+}
+
+static void conn_error(struct uring_conn* c, int err, short what)
+{
+	c->eof = 1;
+	errno = err;
+	bufferevent_trigger_event(c->bev, what, 0);
+}
+
+static void conn_pause_read(struct uring_conn* c)
+{
+	struct timeval tv = {0, URING_RESUME_CHECK};
+	struct io_uring_sqe* sqe;
+
+	c->read_paused = 1;
+	if(c->recv_armed && (sqe = uring_get_sqe(c->e)) != NULL){
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = (uint64_t)(uintptr_t)c | op_recv;
+		sqe->user_data = 0;
+	}
+	if(!evtimer_pending(c->e->resume_ev, NULL))
+		evtimer_add(c->e->resume_ev, &tv);
+}
+
+static void handle_recv(struct uring_conn* c, struct io_uring_cqe* cqe)
+{
+	int res = cqe->res;
+
+	if(cqe->flags & IORING_CQE_F_BUFFER){
+		unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		if(res > 0 && !c->closed)
+			evbuffer_add(bufferevent_get_input(c->bev), c->e->bufs + (size_t)bid * URING_BUF_SIZE, res);
+		uring_recycle_buffer(c->e, bid);
+	}
+	if(!(cqe->flags & IORING_CQE_F_MORE))
+		c->recv_armed = 0;
+
+	if(c->closed || c->eof)
+		return;
+
+	if(res > 0){
+		/*ϲͣȡ(緢)뻺ֹͣ*/
+		if(!(bufferevent_get_enabled(c->bev) & EV_READ)){
+			if(!c->read_paused)
+				conn_pause_read(c);
+			return;
+		}
+		bufferevent_trigger(c->bev, EV_READ, 0);
+	}
+	else if(res == 0)
+		conn_error(c, 0, BEV_EVENT_EOF | BEV_EVENT_READING);
+	else if(res != -ENOBUFS && res != -ECANCELED)
+		conn_error(c, -res, BEV_EVENT_ERROR | BEV_EVENT_READING);
+	/*ENOBUFS: ʱ꣬flushʱ·*/
+}
+
+static void handle_send(struct uring_conn* c, struct io_uring_cqe* cqe)
+{
+	c->sending = 0;
+	if(cqe->res > 0)
+		evbuffer_drain(c->sendq, cqe->res);
+
+	if(c->closed || c->eof)
+		return;
+
+	if(cqe->res < 0){
+		conn_error(c, -cqe->res, BEV_EVENT_ERROR | BEV_EVENT_WRITING);
+		return;
+	}
+
+	/*ˮλ£֪ͨϲ(peersжĶԶѾָ)*/
+	if(evbuffer_get_length(c->sendq) == 0)
+		bufferevent_trigger(c->bev, EV_WRITE, 0);
+}
+
+static void handle_connect(struct uring_conn* c, struct io_uring_cqe* cqe)
+{
+	c->connecting = 0;
+	if(c->closed)
+		return;
+
+	if(cqe->res < 0){
+		conn_error(c, -cqe->res, BEV_EVENT_ERROR);
+		return;
+	}
+
+	c->connected = 1;
+	bufferevent_trigger_event(c->bev, BEV_EVENT_CONNECTED, 0);
+}
+
+static void uring_reap_cq(struct uring_engine* e)
+{
+	unsigned head = *e->cq_head;
+
+	while(head != __atomic_load_n(e->cq_tail, __ATOMIC_ACQUIRE)){
+		struct io_uring_cqe* cqe = &e->cqes[head & *e->cq_mask];
+		struct uring_conn* c = (struct uring_conn *)(uintptr_t)(cqe->user_data & ~(uint64_t)op_mask);
+
+		if(c != NULL){
+			switch(cqe->user_data & op_mask){
+			case op_recv:
+				handle_recv(c, cqe);
+				break;
+			case op_send:
+				handle_send(c, cqe);
+				break;
+			case op_connect:
+				handle_connect(c, cqe);
+				break;
+			}
+		}
+		head++;
+		/*صύµ󣬼ʱ黹ɶеλ*/
+		__atomic_store_n(e->cq_head, head, __ATOMIC_RELEASE);
+	}
+}
+
+static void uring_on_cq(evutil_socket_t fd, short event, void* arg)
+{
+	uint64_t n;
+	struct uring_engine* e = (struct uring_engine *)arg;
+
+	if(read(fd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+		paxos_log_error("Failed to read io_uring eventfd: %s", strerror(errno));
+
+	uring_reap_cq(e);
+	/*ɶʱںݴ¼Ҫں˲ȡ*/
+	if(__atomic_load_n(e->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW){
+		sys_io_uring_enter(e->fd, 0, 0, IORING_ENTER_GETEVENTS);
+		uring_reap_cq(e);
+	}
+
+	uring_flush(e);
+}
+
+static void uring_on_flush(evutil_socket_t fd, short event, void* arg)
+{
+	uring_flush((struct uring_engine *)arg);
+}
+
+static void uring_on_resume(evutil_socket_t fd, short event, void* arg)
+{
+	int paused = 0;
+	struct timeval tv = {0, URING_RESUME_CHECK};
+	struct uring_conn* c;
+	struct uring_engine* e = (struct uring_engine *)arg;
+
+	for(c = e->conns; c != NULL; c = c->next){
+		if(!c->read_paused || c->closed)
+			continue;
+		if(!(bufferevent_get_enabled(c->bev) & EV_READ)){
+			paused = 1;
+			continue;
+		}
+		c->read_paused = 0;
+		/*ȴͣڼ뻺*/
+		if(evbuffer_get_length(bufferevent_get_input(c->bev)) > 0)
+			bufferevent_trigger(c->bev, EV_READ, 0);
+	}
+
+	if(paused)
+		evtimer_add(e->resume_ev, &tv);
+	uring_flush(e);
+}
+
+/*ϲд: ԭأ¼ѭǰͳһύ*/
+static enum bufferevent_filter_result uring_output(struct evbuffer* src, struct evbuffer* dst, ev_ssize_t limit, 
+	enum bufferevent_flush_mode mode, void* ctx)
+{
+	struct uring_conn* c = (struct uring_conn *)ctx;
+	if(evbuffer_get_length(src) > 0)
+		event_active(c->e->flush_ev, EV_WRITE, 0);
+	return BEV_NEED_MORE;
+}
+
+/*filterͷţڱ̣߳ͷengine߳*/
+static void uring_conn_release(void* ctx)
+{
+	struct uring_conn* c = (struct uring_conn *)ctx;
+	__atomic_store_n(&c->closed, 1, __ATOMIC_RELEASE);
+	event_active(c->e->flush_ev, EV_WRITE, 0);
+}
+
+static struct uring_conn* conn_new(struct uring_engine* e, evutil_socket_t fd, int options)
+{
+	struct bufferevent* pair[2];
+	int pair_options = options;
+	struct uring_conn* c = (struct uring_conn *)calloc(1, sizeof(struct uring_conn));
+
+	/*pairշݣֻfilterҪһunderlyingʱصܳpairfilter˳෴*/
+	if(options & BEV_OPT_THREADSAFE)
+		pair_options |= BEV_OPT_DEFER_CALLBACKS | BEV_OPT_UNLOCK_CALLBACKS;
+	if(bufferevent_pair_new(e->base, pair_options, pair) != 0){
+		free(c);
+		return NULL;
+	}
+
+	c->magic = URING_MAGIC;
+	c->e = e;
+	c->fd = fd;
+	c->partner = pair[1];
+	c->sendq = evbuffer_new();
+	bufferevent_setcb(c->partner, NULL, NULL, NULL, c);
+	c->bev = bufferevent_filter_new(pair[0], NULL, uring_output, options | BEV_OPT_CLOSE_ON_FREE, uring_conn_release, c);
+	if(c->bev == NULL){
+		bufferevent_free(pair[0]);
+		bufferevent_free(pair[1]);
+		evbuffer_free(c->sendq);
+		free(c);
+		return NULL;
+	}
+
+	c->next = e->conns;
+	if(e->conns != NULL)
+		e->conns->prev = c;
+	e->conns = c;
+
+	return c;
+}
+
+static struct uring_conn* conn_of(struct bufferevent* bev)
+{
+	void* arg = NULL;
+	struct bufferevent* partner;
+	struct bufferevent* u = bufferevent_get_underlying(bev);
+
+	if(u == NULL || (partner = bufferevent_pair_get_partner(u)) == NULL)
+		return NULL;
+
+	bufferevent_getcb(partner, NULL, NULL, NULL, &arg);
+	if(arg == NULL || ((struct uring_conn *)arg)->magic != URING_MAGIC)
+		return NULL;
+
+	return (struct uring_conn *)arg;
+}
+
+struct bufferevent* uring_accept(struct event_base* b, evutil_socket_t fd, int options)
+{
+	struct uring_conn* c;
+	struct uring_engine* e = engine_get(b);
+
+	if(e == NULL || (c = conn_new(e, fd, options)) == NULL)
+		return NULL;
+
+	c->connected = 1;
+	event_active(e->flush_ev, EV_WRITE, 0);
+	return c->bev;
+}
+
+struct bufferevent* uring_new(struct event_base* b, int options)
+{
+	struct uring_conn* c;
+	struct uring_engine* e = engine_get(b);
+
+	if(e == NULL || (c = conn_new(e, -1, options)) == NULL)
+		return NULL;
+
+	return c->bev;
+}
+
+int uring_connect(struct bufferevent* bev, struct sockaddr* sa, socklen_t len)
+{
+	struct io_uring_sqe* sqe;
+	struct uring_conn* c = conn_of(bev);
+
+	if(c == NULL || c->fd >= 0 || len > sizeof(c->addr)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	c->fd = socket(sa->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(c->fd < 0)
+		return -1;
+
+	/*ύbufferevent_socket_connectʧʱһӳٴϲ*/
+	if((sqe = uring_get_sqe(c->e)) == NULL){
+		close(c->fd);
+		c->fd = -1;
+		c->eof = 1;
+		bufferevent_trigger_event(c->bev, BEV_EVENT_ERROR, BEV_TRIG_DEFER_CALLBACKS);
+		return 0;
+	}
+
+	memcpy(&c->addr, sa, len);
+	c->addrlen = len;
+	sqe->opcode = IORING_OP_CONNECT;
+	sqe->fd = c->fd;
+	sqe->addr = (uint64_t)(uintptr_t)&c->addr;
+	sqe->off = c->addrlen;
+	sqe->user_data = (uint64_t)(uintptr_t)c | op_connect;
+	c->connecting = 1;
+	event_active(c->e->flush_ev, EV_WRITE, 0);
+
+	return 0;
+}
+
+int uring_owns(struct bufferevent* bev)
+{
+	return conn_of(bev) != NULL;
+}
+
+void uring_free(struct event_base* b)
+{
+	struct uring_engine* e;
+	struct uring_engine** link;
+	struct uring_conn* c;
+
+	pthread_mutex_lock(&engines_mutex);
+	for(link = &engines; (e = *link) != NULL; link = &e->next){
+		if(e->base == b){
+			*link = e->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&engines_mutex);
+
+	if(e == NULL)
+		return;
+
+	/*bufferevent(uring_conn_release)ӳִеģ֮꣬󲻻лص*/
+	event_base_loop(b, EVLOOP_NONBLOCK);
+
+	event_free(e->cq_ev);
+	event_free(e->flush_ev);
+	event_free(e->resume_ev);
+
+	/*ȹرio_uringںȡ;Ĳ󲻻ٷӺͽջ*/
+	for(c = e->conns; c != NULL; c = c->next){
+		if(c->fd >= 0)
+			shutdown(c->fd, SHUT_RDWR);
+	}
+	engine_unmap(e);
+
+	while(e->conns != NULL)
+		conn_free(e->conns);
+	free(e);
+}
+
+#else
+
+struct bufferevent* uring_accept(struct event_base* b, evutil_socket_t fd, int options)
+{
+	return NULL;
+}
+
+struct bufferevent* uring_new(struct event_base* b, int options)
+{
+	return NULL;
+}
+
+int uring_connect(struct bufferevent* bev, struct sockaddr* sa, socklen_t len)
+{
+	return -1;
+}
+
+int uring_owns(struct bufferevent* bev)
+{
+	return 0;
+}
+
+void uring_free(struct event_base* b)
+{
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __PAXOS_URING_H
+#define __PAXOS_URING_H
+
+#include <sys/socket.h>
+#include <event2/event.h>
+#include <event2/bufferevent.h>
+
+/*io_uringշ: ෢(multishot)յںṩĻһ¼ѭӵķһύ
+  ϲ㿴Ȼbufferevent(һʹõpairϰһfilter)ӵĽͼlibevent
+  ͷļں˲֧ʱЩNULL/-1˻ͨsocket bufferevent*/
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define PAXOS_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+/*װһѾӵsocket*/
+struct bufferevent*	uring_accept(struct event_base* b, evutil_socket_t fd, int options);
+/*һδӵbufferevent֮uring_connect*/
+struct bufferevent*	uring_new(struct event_base* b, int options);
+/*socketʧܷ-1ύʱʧһԺ󴥷BEV_EVENT_ERROR*/
+int					uring_connect(struct bufferevent* bev, struct sockaddr* sa, socklen_t len);
+/*bevǷuring_accept/uring_new*/
+int					uring_owns(struct bufferevent* bev);
+/*event_base_free֮ǰãͷevent_baseenginebaseϵbuffereventѾȫͷţ¼ѭ*/
+void				uring_free(struct event_base* b);
+
+#endif